@@ -0,0 +1,734 @@
+/*
+ *  C++ Interface to Rserve - asynchronous client
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+#include "AsyncRconnection.h"
+
+#ifdef __linux__
+
+#include "sisocks.h"
+#include "Ruring.h"
+
+#include <sys/epoll.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <algorithm>
+
+#ifndef AF_LOCAL
+#define AF_LOCAL AF_UNIX
+#endif
+
+// max. number of events fetched by one epoll_wait()
+#define MAX_EVENTS 256
+// max. number of segments handed to the kernel in one gather call
+#define MAX_SEND_SEGMENTS 64
+// io_uring: submission queue entries and registered receive buffers
+#define RING_ENTRIES 256
+#define RING_BUFFERS 64
+#define RING_BUFFER_SIZE (16*1024)
+
+namespace Rconnection2 {
+
+#ifdef RCONNECTION2_IO_URING
+	// one submitted io_uring operation, its address is the user_data of the SQE
+	struct RuringOp
+	{
+		enum Kind { op_connect, op_recv, op_send };
+
+		std::shared_ptr<AsyncRconnection> conn; // alive until the completion is reaped
+		Kind kind;
+		unsigned int gen;
+		int buf;                           // registered buffer or -1
+		std::vector<char> own;             // receive buffer if no registered one was free
+		std::shared_ptr<Rmessage> target;  // receive straight into this message
+		struct msghdr mh;
+		struct iovec iov[MAX_SEND_SEGMENTS];
+	};
+#endif
+
+	//===================================== Rreactor
+
+	Rreactor::Rreactor(Backend backend)
+		:
+		backend_(be_epoll),
+		epfd_(-1),
+		watched_(0),
+		stopped_(false),
+		batch_(NULL),
+		batch_n_(0),
+		ring_(NULL),
+		inflight_(0)
+	{
+#ifdef RCONNECTION2_IO_URING
+		if (backend == be_uring)
+		{
+			ring_ = Ruring::create(RING_ENTRIES, RING_BUFFERS, RING_BUFFER_SIZE).release();
+			if (ring_)
+			{
+				backend_ = be_uring;
+				return;
+			}
+		}
+#else
+		(void)backend;
+#endif
+		epfd_ = epoll_create1(EPOLL_CLOEXEC);
+	}
+
+	Rreactor::~Rreactor()
+	{
+		if (epfd_ >= 0) close(epfd_);
+#ifdef RCONNECTION2_IO_URING
+		delete ring_;
+#endif
+	}
+
+	int Rreactor::watch(AsyncRconnection *conn, SOCKET s, bool want_write, bool added)
+	{
+		if (ring_)
+		{
+			// the connection posts its own operations, just count it
+			if (!added) ++watched_;
+			return 0;
+		}
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN | EPOLLRDHUP | (want_write ? (unsigned int)EPOLLOUT : 0u);
+		ev.data.ptr = conn;
+		if (epoll_ctl(epfd_, added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, s, &ev))
+			return -1;
+		if (!added) ++watched_;
+		return 0;
+	}
+
+	void Rreactor::unwatch(AsyncRconnection *conn, SOCKET s)
+	{
+		if (ring_)
+		{
+			--watched_;
+			return;
+		}
+		if (!epoll_ctl(epfd_, EPOLL_CTL_DEL, s, NULL))
+			--watched_;
+		// the connection may be going away - drop its events still queued in this batch
+		for (int i = 0; i < batch_n_; ++i)
+			if (batch_[i].data.ptr == conn)
+				batch_[i].data.ptr = NULL;
+	}
+
+#ifdef RCONNECTION2_IO_URING
+	struct io_uring_sqe *Rreactor::getSqe(RuringOp *op)
+	{
+		struct io_uring_sqe *sqe = ring_->getSqe();
+		if (!sqe) return NULL;
+		sqe->user_data = (uint64_t)(uintptr_t)op;
+		++inflight_;
+		return sqe;
+	}
+
+	int Rreactor::runRing(int timeout_ms)
+	{
+		// everything queued since the last call goes out with this one system call
+		// nothing in flight and no timeout - waiting would never end
+		unsigned int wait = (timeout_ms > 0 || (timeout_ms < 0 && inflight_ > 0)) ? 1 : 0;
+		if (ring_->submit(wait, timeout_ms)) return -1;
+		return (int)ring_->reap([this](const struct io_uring_cqe& cqe)
+		{
+			RuringOp *op = (RuringOp*)(uintptr_t)cqe.user_data;
+			--inflight_;
+			std::shared_ptr<AsyncRconnection> conn;
+			conn.swap(op->conn);
+			conn->complete(op, cqe.res);
+			delete op;
+		});
+	}
+#else
+	struct io_uring_sqe *Rreactor::getSqe(RuringOp *)
+	{
+		return NULL;
+	}
+
+	int Rreactor::runRing(int)
+	{
+		return -1;
+	}
+#endif
+
+	int Rreactor::runOnce(int timeout_ms)
+	{
+		if (ring_) return runRing(timeout_ms);
+
+		struct epoll_event ev[MAX_EVENTS];
+		int n = epoll_wait(epfd_, ev, MAX_EVENTS, timeout_ms);
+		if (n < 0)
+			return (errno == EINTR) ? 0 : -1;
+		batch_ = ev;
+		batch_n_ = n;
+		for (int i = 0; i < n; ++i)
+		{
+			if (!ev[i].data.ptr) continue;
+			// keep the connection alive while its callbacks run
+			std::shared_ptr<AsyncRconnection> conn = static_cast<AsyncRconnection*>(ev[i].data.ptr)->shared_from_this();
+			conn->handleEvents(ev[i].events);
+		}
+		batch_ = NULL;
+		batch_n_ = 0;
+		return n;
+	}
+
+	void Rreactor::run()
+	{
+		stopped_ = false;
+		// with io_uring, operations of closed sockets still have to be reaped
+		while (!stopped_ && (watched_ > 0 || inflight_ > 0))
+			if (runOnce(-1) < 0) break;
+	}
+
+	//===================================== AsyncRconnection
+
+	// numeric addresses without a lookup, names through getaddrinfo() (blocking)
+	static bool resolveHost(const char *host, uint32_t& addr)
+	{
+		struct in_addr a;
+		if (inet_pton(AF_INET, host, &a) == 1)
+		{
+			addr = a.s_addr;
+			return true;
+		}
+		struct addrinfo hints, *res = NULL;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		if (getaddrinfo(host, NULL, &hints, &res) || !res)
+			return false;
+		addr = ((struct sockaddr_in*)res->ai_addr)->sin_addr.s_addr;
+		freeaddrinfo(res);
+		return true;
+	}
+
+	AsyncRconnection::AsyncRconnection(const std::shared_ptr<Rreactor>& reactor, const char *host, int port)
+		:
+		reactor_(reactor),
+		host_(host),
+		port_(port),
+		family_((port == -1) ? AF_LOCAL : AF_INET),
+		addr_(0),
+		resolved_(false),
+		s_(-1),
+		state_(st_closed),
+		on_connect_(),
+		want_write_(false),
+		proto_(),
+		waiting_(),
+		gen_(0),
+		recv_posted_(false),
+		send_posted_(false)
+	{
+		if (family_ == AF_INET)
+			resolved_ = resolveHost(host_.c_str(), addr_);
+	}
+
+	int AsyncRconnection::connect(const StatusCallback& done)
+	{
+		struct sockaddr_un sau;
+		SAIN sai;
+
+		if (state_ != st_closed) return -1;
+		if (!reactor_ || !reactor_->valid()) return CERR_not_supported;
+		if (family_ == AF_INET && !resolved_) return CERR_connect_failed;
+
+		s_ = socket(family_, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (s_ == -1) return -1; // connect failed
+
+		int i;
+		if (family_ == AF_INET)
+		{
+			int opt = 1;
+			setsockopt(s_, IPPROTO_TCP, TCP_NODELAY, (const char*) &opt, sizeof(opt));
+			build_sin(&sai, NULL, port_);
+			sai.sin_addr.s_addr = addr_;
+			i = ::connect(s_, (SA*)&sai, sizeof(sai));
+		}
+		else
+		{
+			memset(&sau, 0, sizeof(sau));
+			sau.sun_family = AF_LOCAL;
+			strncpy(sau.sun_path, host_.c_str(), sizeof(sau.sun_path) - 1);
+			i = ::connect(s_, (SA*)&sau, sizeof(sau));
+		}
+		if (i == -1 && errno != EINPROGRESS)
+		{
+			closesocket(s_);
+			s_ = -1;
+			return -1; // connect failed
+		}
+
+		state_ = (i == 0) ? st_handshake : st_connecting;
+		proto_.reset();
+		want_write_ = (state_ == st_connecting);
+		on_connect_ = done;
+		if (reactor_->watch(this, s_, want_write_, false))
+		{
+			closesocket(s_);
+			s_ = -1;
+			state_ = st_closed;
+			return -1;
+		}
+		if (usesRing() && postRecv())
+		{
+			on_connect_ = StatusCallback();
+			closeSocket();
+			return -1;
+		}
+		return 0;
+	}
+
+	bool AsyncRconnection::closeSocket()
+	{
+		if (s_ == -1) return false;
+		if (reactor_) reactor_->unwatch(this, s_);
+		if (usesRing())
+		{
+			// operations still in flight complete right away and are ignored
+			++gen_;
+			recv_posted_ = false;
+			send_posted_ = false;
+			shutdown(s_, SHUT_RDWR);
+		}
+		closesocket(s_);
+		s_ = -1;
+		state_ = st_closed;
+		return true;
+	}
+
+	bool AsyncRconnection::disconnect()
+	{
+		if (s_ == -1) return false;
+		// requests still in flight will never see their reply
+		fail(CERR_not_connected);
+		return true;
+	}
+
+	void AsyncRconnection::fail(int status)
+	{
+		closeSocket();
+		// detach everything first - callbacks may reconnect and queue new work
+		StatusCallback cc;
+		cc.swap(on_connect_);
+		std::deque<MessageCallback> w;
+		w.swap(waiting_);
+		proto_.reset();
+		if (cc) cc(status);
+		for (auto& cb : w)
+			if (cb) cb(status, std::shared_ptr<Rmessage>());
+	}
+
+	int AsyncRconnection::updateInterest()
+	{
+		bool ww = (state_ == st_connecting) || (state_ == st_ready && proto_.hasOutput());
+		if (ww == want_write_) return 0;
+		want_write_ = ww;
+		return reactor_->watch(this, s_, want_write_, true);
+	}
+
+	void AsyncRconnection::handleEvents(unsigned int events)
+	{
+		if (state_ == st_connecting)
+		{
+			int err = 0;
+			socklen_t len = sizeof(err);
+			if ((events & (EPOLLERR | EPOLLHUP)) || getsockopt(s_, SOL_SOCKET, SO_ERROR, &err, &len) || err)
+			{
+				fail(CERR_connect_failed);
+				return;
+			}
+			if (!(events & EPOLLOUT)) return;
+			state_ = st_handshake;
+			if (updateInterest())
+			{
+				fail(CERR_io_error);
+				return;
+			}
+		}
+
+		if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+		{
+			int res = readAvailable();
+			if (res)
+			{
+				fail(res);
+				return;
+			}
+		}
+
+		if (state_ == st_ready && (events & EPOLLOUT))
+		{
+			int res = flush();
+			if (res) fail(res);
+		}
+	}
+
+	int AsyncRconnection::flush()
+	{
+		if (usesRing()) return postSend();
+		while (proto_.hasOutput())
+		{
+			IoSegment segs[MAX_SEND_SEGMENTS];
+			struct iovec iov[MAX_SEND_SEGMENTS];
+			int n = proto_.pendingOutput(segs, MAX_SEND_SEGMENTS);
+			for (int i = 0; i < n; ++i)
+			{
+				iov[i].iov_base = (void*)segs[i].data;
+				iov[i].iov_len = segs[i].len;
+			}
+			struct msghdr mh;
+			memset(&mh, 0, sizeof(mh));
+			mh.msg_iov = iov;
+			mh.msg_iovlen = n;
+			ssize_t sent = sendmsg(s_, &mh, MSG_NOSIGNAL | MSG_DONTWAIT);
+			if (sent < 0)
+			{
+				if (errno == EINTR) continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+				return CERR_send_error;
+			}
+			proto_.consumeOutput(sent);
+		}
+		return updateInterest() ? CERR_io_error : 0;
+	}
+
+	int AsyncRconnection::readAvailable()
+	{
+		for (;;)
+		{
+			size_t avail;
+			char *p = proto_.readBuffer(avail);
+			if (!p) return proto_.error();
+			ssize_t n = recv(s_, p, avail, 0);
+			if (n == 0) return (state_ == st_handshake) ? CERR_handshake_failed : CERR_peer_closed;
+			if (n < 0)
+			{
+				if (errno == EINTR) continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+				return (state_ == st_handshake) ? CERR_handshake_failed : CERR_io_error;
+			}
+			int res = proto_.commitRead(n);
+			if (res) return res;
+			res = processInput();
+			if (res) return (res > 0) ? 0 : res;
+		}
+	}
+
+	int AsyncRconnection::processInput()
+	{
+		int res;
+		if (state_ == st_handshake && proto_.state() == Rprotocol::st_ready)
+		{
+			state_ = st_ready;
+			StatusCallback cc;
+			cc.swap(on_connect_);
+			if (cc) cc(0);
+			if (state_ != st_ready) return 1;
+			res = flush();
+			if (res) return res;
+		}
+
+		while (proto_.hasMessage())
+		{
+			std::shared_ptr<Rmessage> msg = proto_.nextMessage();
+			if (waiting_.empty())
+				return CERR_malformed_packet; // a reply nobody asked for - the stream is out of sync
+			MessageCallback cb = waiting_.front();
+			waiting_.pop_front();
+			res = (msg->get_header().cmd & RESP_ERR) == RESP_ERR ? -20 : 0;
+			if (cb) cb(res, msg);
+			if (state_ != st_ready) return 1;
+		}
+
+		// answers to OOB messages
+		if (state_ == st_ready && proto_.hasOutput())
+		{
+			res = flush();
+			if (res) return res;
+		}
+		return 0;
+	}
+
+	bool AsyncRconnection::usesRing() const
+	{
+		return reactor_ && reactor_->ring_;
+	}
+
+#ifdef RCONNECTION2_IO_URING
+	int AsyncRconnection::postRecv()
+	{
+		if (recv_posted_ || s_ == -1) return 0;
+		Ruring *ring = reactor_->ring_;
+		RuringOp *op = new RuringOp();
+		op->gen = gen_;
+		op->buf = -1;
+		struct io_uring_sqe *sqe = reactor_->getSqe(op);
+		if (!sqe)
+		{
+			delete op;
+			return CERR_io_error;
+		}
+		op->conn = shared_from_this();
+		sqe->fd = s_;
+		if (state_ == st_connecting)
+		{
+			op->kind = RuringOp::op_connect;
+			sqe->opcode = IORING_OP_POLL_ADD;
+			sqe->poll32_events = POLLOUT;
+		}
+		else
+		{
+			op->kind = RuringOp::op_recv;
+			op->target = proto_.inPlaceTarget();
+			if (op->target)
+			{
+				// bulk payload - no copy at all
+				size_t avail;
+				char *p = proto_.readBuffer(avail);
+				sqe->opcode = IORING_OP_RECV;
+				sqe->addr = (uint64_t)(uintptr_t)p;
+				sqe->len = (unsigned int)std::min(avail, (size_t)0x40000000);
+			}
+			else if ((op->buf = ring->acquireBuffer()) >= 0)
+			{
+				sqe->opcode = IORING_OP_READ_FIXED;
+				sqe->addr = (uint64_t)(uintptr_t)ring->buffer(op->buf);
+				sqe->len = (unsigned int)ring->bufferSize();
+				sqe->buf_index = (unsigned short)op->buf;
+			}
+			else
+			{
+				op->own.resize(RING_BUFFER_SIZE);
+				sqe->opcode = IORING_OP_RECV;
+				sqe->addr = (uint64_t)(uintptr_t)&op->own[0];
+				sqe->len = (unsigned int)op->own.size();
+			}
+		}
+		recv_posted_ = true;
+		return 0;
+	}
+
+	int AsyncRconnection::postSend()
+	{
+		if (send_posted_ || state_ != st_ready || !proto_.hasOutput()) return 0;
+		RuringOp *op = new RuringOp();
+		op->kind = RuringOp::op_send;
+		op->gen = gen_;
+		op->buf = -1;
+		struct io_uring_sqe *sqe = reactor_->getSqe(op);
+		if (!sqe)
+		{
+			delete op;
+			return CERR_io_error;
+		}
+		op->conn = shared_from_this();
+		IoSegment segs[MAX_SEND_SEGMENTS];
+		int n = proto_.pendingOutput(segs, MAX_SEND_SEGMENTS);
+		size_t total = 0;
+		for (int i = 0; i < n; ++i)
+		{
+			op->iov[i].iov_base = (void*)segs[i].data;
+			op->iov[i].iov_len = segs[i].len;
+			total += segs[i].len;
+		}
+		op->mh.msg_iov = op->iov;
+		op->mh.msg_iovlen = n;
+		sqe->opcode = IORING_OP_SENDMSG;
+		sqe->fd = s_;
+		sqe->addr = (uint64_t)(uintptr_t)&op->mh;
+		sqe->len = 1;
+		sqe->msg_flags = MSG_NOSIGNAL;
+		// the kernel reads these bytes later, OOB answers must queue behind them
+		proto_.lockOutput(total);
+		send_posted_ = true;
+		return 0;
+	}
+
+	void AsyncRconnection::complete(RuringOp *op, int res)
+	{
+		Ruring *ring = reactor_->ring_;
+		int status = 0;
+		if (op->gen == gen_)
+		{
+			switch (op->kind)
+			{
+				case RuringOp::op_connect:
+				{
+					recv_posted_ = false;
+					int err = 0;
+					socklen_t len = sizeof(err);
+					if (res < 0 || (res & (POLLERR | POLLHUP)) || getsockopt(s_, SOL_SOCKET, SO_ERROR, &err, &len) || err)
+					{
+						status = CERR_connect_failed;
+						break;
+					}
+					state_ = st_handshake;
+					status = postRecv();
+					break;
+				}
+
+				case RuringOp::op_recv:
+					recv_posted_ = false;
+					if (res == -EAGAIN || res == -EINTR)
+					{
+						status = postRecv();
+						break;
+					}
+					if (res <= 0)
+					{
+						status = (state_ == st_handshake) ? CERR_handshake_failed : (res ? CERR_io_error : CERR_peer_closed);
+						break;
+					}
+					if (op->target)
+						status = proto_.commitRead(res);
+					else if (op->buf >= 0)
+					{
+						status = proto_.feed(ring->buffer(op->buf), res);
+						ring->releaseBuffer(op->buf);
+						op->buf = -1;
+					}
+					else
+						status = proto_.feed(&op->own[0], res);
+					if (!status) status = processInput();
+					// a callback closed the connection, it may even have opened a new one
+					if (status > 0) status = 0;
+					else if (!status) status = postRecv();
+					break;
+
+				case RuringOp::op_send:
+					send_posted_ = false;
+					proto_.lockOutput(0);
+					if (res == -EAGAIN || res == -EINTR)
+					{
+						status = postSend();
+						break;
+					}
+					if (res < 0)
+					{
+						status = CERR_send_error;
+						break;
+					}
+					proto_.consumeOutput(res);
+					status = postSend();
+					break;
+			}
+		}
+		if (op->buf >= 0) ring->releaseBuffer(op->buf);
+		if (status) fail(status);
+	}
+#else
+	int AsyncRconnection::postRecv()
+	{
+		return CERR_not_supported;
+	}
+
+	int AsyncRconnection::postSend()
+	{
+		return CERR_not_supported;
+	}
+
+	void AsyncRconnection::complete(RuringOp *, int)
+	{
+	}
+#endif
+
+	int AsyncRconnection::submit(int res, const MessageCallback& done)
+	{
+		if (res) return res;
+		waiting_.push_back(done);
+		if (state_ != st_ready) return 0; // written after the handshake
+		res = flush();
+		if (res)
+		{
+			// report through the callbacks, the request itself was accepted
+			fail(res);
+		}
+		return 0;
+	}
+
+	int AsyncRconnection::request(const std::shared_ptr<Rmessage>& msg, const MessageCallback& done)
+	{
+		if (state_ == st_closed) return CERR_not_connected;
+		return submit(proto_.encode(*msg, msg), done);
+	}
+
+	int AsyncRconnection::eval(const char *cmd, const EvalCallback& done)
+	{
+		return request(Rmessage::create(CMD_eval, cmd),
+			[done](int status, const std::shared_ptr<Rmessage>& msg)
+		{
+			std::shared_ptr<Rexp> exp;
+			if (!status) exp = decodeSEXPResponse(msg, &status);
+			if (done) done(status, exp);
+		});
+	}
+
+	int AsyncRconnection::voidEval(const char *cmd, const StatusCallback& done)
+	{
+		return request(Rmessage::create(CMD_voidEval, cmd),
+			[done](int status, const std::shared_ptr<Rmessage>&)
+		{
+			if (done) done(status);
+		});
+	}
+
+	int AsyncRconnection::assign(const char *symbol, const std::shared_ptr<Rexp>& exp, const StatusCallback& done)
+	{
+		if (state_ == st_closed) return CERR_not_connected;
+		return submit(proto_.encodeAssign(symbol, *exp, exp),
+			[done](int status, const std::shared_ptr<Rmessage>& msg)
+		{
+			if (!status) status = CMD_STAT(msg->command());
+			if (done) done(status);
+		});
+	}
+
+	int AsyncRconnection::login(const char *user, const char *pwd, const StatusCallback& done)
+	{
+		if (state_ != st_ready) return CERR_not_connected;
+		if (!(proto_.auth()&A_required))
+		{
+			if (done) done(0);
+			return 0;
+		}
+		std::vector<char> authbuf;
+		int res = buildLoginString(proto_.auth(), proto_.salt(), user, pwd, authbuf);
+		if (res) return res;
+		return request(Rmessage::create(CMD_login, &authbuf[0]),
+			[done](int status, const std::shared_ptr<Rmessage>& msg)
+		{
+			if (!status) status = CMD_STAT(msg->command());
+			if (done) done(status);
+		});
+	}
+
+} // namespace Rconnection2
+
+#endif // __linux__
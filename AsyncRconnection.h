@@ -0,0 +1,221 @@
+/*
+ *  C++ Interface to Rserve - asynchronous client
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+/* AsyncRconnection multiplexes many Rserve sessions over a single thread.
+   Each connection uses a non-blocking socket registered with an Rreactor
+   (epoll based, so Linux only). Requests are queued, written as soon as the
+   socket accepts data and completed through callbacks from Rreactor::runOnce(),
+   in the order they were issued. Framing and the handshake are done by
+   Rprotocol and results are decoded with the same Rexp::create() as the
+   blocking client.
+
+   When built with IO_URING=1 the reactor can use io_uring instead: the
+   receives and sends of all connections are queued as submission entries
+   and handed to the kernel with a single system call per runOnce(), which
+   also collects the completions. Large payloads are received straight into
+   the message buffer, everything else through registered buffers. Measure
+   before switching (make IO_URING=1 bench): on one core shared with the
+   server it was no faster than epoll, and slower for large replies.
+*/
+#pragma once
+
+#ifndef __ASYNCRCONNECTION_H__
+#define __ASYNCRCONNECTION_H__
+
+#include "Rconnection2.h"
+
+#ifdef __linux__
+
+#include <functional>
+#include <deque>
+
+struct epoll_event;
+struct io_uring_sqe;
+
+namespace Rconnection2 {
+
+	class AsyncRconnection;
+	class Ruring;
+	struct RuringOp;
+
+	//===================================== Rreactor --- epoll / io_uring event loop
+
+	class RCONNECTION2_API Rreactor
+	{
+	private:
+		explicit Rreactor(const Rreactor&);
+		Rreactor& operator=(const Rreactor&);
+
+	public:
+		enum Backend { be_epoll, be_uring };
+
+	protected:
+		Backend backend_;
+		int epfd_;
+		size_t watched_;
+		bool stopped_;
+		// events of the batch being dispatched, see unwatch()
+		struct epoll_event *batch_;
+		int batch_n_;
+		// be_uring only
+		Ruring *ring_;
+		size_t inflight_; // operations submitted but not completed
+
+		explicit Rreactor(Backend backend);
+
+		friend class AsyncRconnection;
+		int watch(AsyncRconnection *conn, SOCKET s, bool want_write, bool added);
+		void unwatch(AsyncRconnection *conn, SOCKET s);
+		/** queues an operation of op; it is submitted by the next runOnce() */
+		struct io_uring_sqe *getSqe(RuringOp *op);
+		int runRing(int timeout_ms);
+
+	public:
+		/** be_uring needs a build with RCONNECTION2_IO_URING and a kernel with
+			io_uring (5.7+), otherwise the reactor silently uses epoll */
+		static std::shared_ptr<Rreactor> create(Backend backend = be_epoll)
+		{
+			return std::shared_ptr<Rreactor>(new Rreactor(backend));
+		}
+
+		~Rreactor();
+
+		bool valid() const { return epfd_ >= 0 || ring_; }
+		Backend backend() const { return backend_; }
+		size_t watched() const { return watched_; }
+
+		/** waits up to timeout_ms (-1 = forever) for socket events and runs
+			the resulting callbacks. returns the number of events handled or -1 */
+		int runOnce(int timeout_ms = -1);
+
+		/** runs the loop until stop() is called or no sockets are left */
+		void run();
+		void stop() { stopped_ = true; }
+	};
+
+	//===================================== AsyncRconnection --- non-blocking Rserve session
+
+	class RCONNECTION2_API AsyncRconnection : public IRconnection, public std::enable_shared_from_this < AsyncRconnection >
+	{
+	public:
+		typedef std::function<void(int status)> StatusCallback;
+		typedef std::function<void(int status, const std::shared_ptr<Rexp>& exp)> EvalCallback;
+		typedef std::function<void(int status, const std::shared_ptr<Rmessage>& msg)> MessageCallback;
+
+	protected:
+		enum State { st_closed, st_connecting, st_handshake, st_ready };
+
+		std::shared_ptr<Rreactor> reactor_;
+		std::string host_;
+		int port_;
+		int family_;
+		uint32_t addr_;   // AF_INET, network byte order
+		bool resolved_;
+		SOCKET s_;
+		State state_;
+		StatusCallback on_connect_;
+		bool want_write_;
+
+		// framing, handshake and the output queue
+		Rprotocol proto_;
+		std::deque<MessageCallback> waiting_; // one per request, in submission order
+
+		// io_uring: at most one receive and one send in flight. gen_ changes
+		// with every socket, completions of an older one are ignored
+		unsigned int gen_;
+		bool recv_posted_;
+		bool send_posted_;
+
+		AsyncRconnection(const std::shared_ptr<Rreactor>& reactor, const char *host, int port);
+
+		friend class Rreactor;
+		void handleEvents(unsigned int events);
+		int flush();
+		int readAvailable();
+		/** handshake and replies after new input. returns 0, an error or 1
+			if a callback closed the connection */
+		int processInput();
+		bool usesRing() const;
+		int postRecv();
+		int postSend();
+		void complete(RuringOp *op, int res);
+		bool closeSocket();
+		void fail(int status);
+		int updateInterest();
+		int submit(int res, const MessageCallback& done);
+
+	public:
+		/** host - either host name or unix socket path
+			port - either TCP port or -1 if unix sockets should be used
+			a host name is resolved here, on the calling thread, and never
+			again - connect() does not block the reactor on DNS. keep this
+			off the reactor thread unless host is a numeric address */
+		static std::shared_ptr<AsyncRconnection> create(const std::shared_ptr<Rreactor>& reactor,
+			const char *host = "127.0.0.1", int port = default_Rsrv_port)
+		{
+			return std::shared_ptr<AsyncRconnection>(new AsyncRconnection(reactor, host, port));
+		}
+
+		virtual ~AsyncRconnection()
+		{
+			disconnect();
+		}
+
+		/** starts connecting; done is called from the reactor once the ID string
+			has been checked. requests may be queued right away, they are
+			written after the handshake. CERR_connect_failed if the host
+			could not be resolved by create() */
+		int connect(const StatusCallback& done);
+		virtual int connect() { return connect(StatusCallback()); }
+		/** closes the socket, pending callbacks get CERR_not_connected */
+		virtual bool disconnect();
+		virtual SOCKET getSocket() const { return s_; }
+
+		bool isConnected() const { return state_ != st_closed; }
+		bool isReady() const { return state_ == st_ready; }
+
+		/** handlers for out-of-band frames, called from the reactor (see Rprotocol) */
+		void setOOBHandlers(const Rprotocol::OOBSendHandler& on_send,
+			const Rprotocol::OOBMessageHandler& on_msg = Rprotocol::OOBMessageHandler())
+		{
+			proto_.setOOBHandlers(on_send, on_msg);
+		}
+
+		/** number of requests still waiting for their reply */
+		size_t pending() const { return waiting_.size(); }
+
+		/* --- requests - all return 0 if the request was queued, the result
+		       is passed to the callback later. the status values are the
+		       same as the ones of the blocking Rconnection --- */
+
+		int request(const std::shared_ptr<Rmessage>& msg, const MessageCallback& done);
+		int eval(const char *cmd, const EvalCallback& done);
+		int voidEval(const char *cmd, const StatusCallback& done);
+		int assign(const char *symbol, const std::shared_ptr<Rexp>& exp, const StatusCallback& done);
+
+		/** requires the handshake to be complete, e.g. call it from the connect callback */
+		int login(const char *user, const char *pwd, const StatusCallback& done);
+	};
+
+} // namespace Rconnection2
+
+#endif // __linux__
+
+#endif
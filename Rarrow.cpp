@@ -0,0 +1,292 @@
+/*
+ *  C++ Interface to Rserve - export to the Arrow C Data Interface
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+#include "Rarrow.h"
+#include "Rdataframe.h"
+
+#include <climits>
+#include <cmath>
+
+namespace Rconnection2 {
+
+	// private_data of exported arrays - everything the buffers point to
+	struct ArrowArrayData
+	{
+		std::shared_ptr<Rexp> keep; // owns the message buffer of zero-copy values
+		std::vector<uint8_t> validity;
+		std::vector<uint8_t> bits;
+		std::vector<int32_t> ints;
+		std::vector<int64_t> longs;
+		std::vector<char> chars;
+		const void *buffers[3];
+		std::vector<struct ArrowArray*> children;
+		struct ArrowArray *dictionary;
+	};
+
+	struct ArrowSchemaData
+	{
+		std::string format;
+		std::string name;
+		std::vector<struct ArrowSchema*> children;
+		struct ArrowSchema *dictionary;
+	};
+
+	static void releaseArray(struct ArrowArray *a)
+	{
+		ArrowArrayData *d = (ArrowArrayData*)a->private_data;
+		for (struct ArrowArray *c : d->children)
+		{
+			if (c->release) c->release(c);
+			delete c;
+		}
+		if (d->dictionary)
+		{
+			if (d->dictionary->release) d->dictionary->release(d->dictionary);
+			delete d->dictionary;
+		}
+		delete d;
+		a->release = NULL;
+	}
+
+	static void releaseSchema(struct ArrowSchema *s)
+	{
+		ArrowSchemaData *d = (ArrowSchemaData*)s->private_data;
+		for (struct ArrowSchema *c : d->children)
+		{
+			if (c->release) c->release(c);
+			delete c;
+		}
+		if (d->dictionary)
+		{
+			if (d->dictionary->release) d->dictionary->release(d->dictionary);
+			delete d->dictionary;
+		}
+		delete d;
+		s->release = NULL;
+	}
+
+	static ArrowArrayData *initArray(struct ArrowArray *a, int64_t length, int n_buffers)
+	{
+		ArrowArrayData *d = new ArrowArrayData();
+		d->buffers[0] = d->buffers[1] = d->buffers[2] = NULL;
+		d->dictionary = NULL;
+		memset(a, 0, sizeof(*a));
+		a->length = length;
+		a->n_buffers = n_buffers;
+		a->buffers = d->buffers;
+		a->release = releaseArray;
+		a->private_data = d;
+		return d;
+	}
+
+	static ArrowSchemaData *initSchema(struct ArrowSchema *s, const char *format, const char *name)
+	{
+		ArrowSchemaData *d = new ArrowSchemaData();
+		d->format = format;
+		if (name) d->name = name;
+		d->dictionary = NULL;
+		memset(s, 0, sizeof(*s));
+		s->format = d->format.c_str();
+		s->name = d->name.c_str();
+		s->flags = ARROW_FLAG_NULLABLE;
+		s->release = releaseSchema;
+		s->private_data = d;
+		return d;
+	}
+
+	static struct ArrowArray *newArray()
+	{
+		struct ArrowArray *a = new struct ArrowArray;
+		memset(a, 0, sizeof(*a));
+		return a;
+	}
+
+	static struct ArrowSchema *newSchema()
+	{
+		struct ArrowSchema *s = new struct ArrowSchema;
+		memset(s, 0, sizeof(*s));
+		return s;
+	}
+
+	/** validity bitmap from the NA predicate, only allocated if there are NAs.
+		sets null_count */
+	template<class IsNA>
+	static void buildValidity(struct ArrowArray *a, ArrowArrayData *d, size_t n, const IsNA& isNA)
+	{
+		int64_t nulls = 0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (!isNA(i)) continue;
+			if (!nulls)
+				d->validity.assign((n + 7) / 8, 0xff);
+			d->validity[i >> 3] &= (uint8_t)~(1u << (i & 7));
+			++nulls;
+		}
+		a->null_count = nulls;
+		if (nulls) d->buffers[0] = &d->validity[0];
+	}
+
+	// NA_real_ is the NaN with 1954 in its low word, other NaNs are values
+	static inline bool isNAreal(double x)
+	{
+		if (!std::isnan(x)) return false;
+		uint64_t b;
+		memcpy(&b, &x, sizeof(b));
+		return (uint32_t)b == 1954;
+	}
+
+	/** utf8 (or large utf8 beyond 2GB) array of strs, NA entries are null */
+	static void exportStrings(const Rstrings& strs, const char *name, struct ArrowArray *array, struct ArrowSchema *schema)
+	{
+		size_t n = strs.strings().size(), total = 0;
+		for (size_t i = 0; i < n; ++i)
+			total += strs.view(i).size;
+		bool large = total > (size_t)INT32_MAX;
+
+		ArrowArrayData *d = initArray(array, n, 3);
+		initSchema(schema, large ? "U" : "u", name);
+		buildValidity(array, d, n, [&strs](size_t i) { return strs.isNA(i); });
+
+		d->chars.resize(total ? total : 1);
+		if (large) d->longs.resize(n + 1); else d->ints.resize(n + 1);
+		size_t off = 0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (large) d->longs[i] = (int64_t)off; else d->ints[i] = (int32_t)off;
+			RstringRef r = strs.view(i);
+			if (r.size) memcpy(&d->chars[off], r.data, r.size);
+			off += r.size;
+		}
+		if (large) d->longs[n] = (int64_t)off; else d->ints[n] = (int32_t)off;
+		d->buffers[1] = large ? (const void*)&d->longs[0] : (const void*)&d->ints[0];
+		d->buffers[2] = &d->chars[0];
+	}
+
+	static int exportColumn(const std::shared_ptr<Rexp>& exp, const char *name, struct ArrowArray *array,
+		struct ArrowSchema *schema)
+	{
+		switch (Rdataframe::typeOf(*exp))
+		{
+			case Rdataframe::col_int:
+			{
+				Rinteger *p = static_cast<Rinteger*>(exp.get());
+				const int *v = p->intArray();
+				size_t n = p->length();
+				ArrowArrayData *d = initArray(array, n, 2);
+				initSchema(schema, "i", name);
+				d->keep = exp;
+				buildValidity(array, d, n, [v](size_t i) { return v[i] == INT_MIN; });
+				d->buffers[1] = v;
+				return 0;
+			}
+
+			case Rdataframe::col_double:
+			{
+				Rdouble *p = static_cast<Rdouble*>(exp.get());
+				const double *v = p->doubleArray();
+				size_t n = p->length();
+				ArrowArrayData *d = initArray(array, n, 2);
+				initSchema(schema, "g", name);
+				d->keep = exp;
+				buildValidity(array, d, n, [v](size_t i) { return isNAreal(v[i]); });
+				d->buffers[1] = v;
+				return 0;
+			}
+
+			case Rdataframe::col_logical:
+			{
+				Rspan<unsigned char> v = Rdataframe::logicalData(*exp);
+				ArrowArrayData *d = initArray(array, v.size, 2);
+				initSchema(schema, "b", name);
+				buildValidity(array, d, v.size, [&v](size_t i) { return v[i] > 1; });
+				d->bits.assign((v.size + 7) / 8 + 1, 0);
+				for (size_t i = 0; i < v.size; ++i)
+					if (v[i] == 1) d->bits[i >> 3] |= (uint8_t)(1u << (i & 7));
+				d->buffers[1] = &d->bits[0];
+				return 0;
+			}
+
+			case Rdataframe::col_string:
+				exportStrings(*static_cast<Rstrings*>(exp.get()), name, array, schema);
+				return 0;
+
+			case Rdataframe::col_factor:
+			{
+				std::shared_ptr<Rexp> lv = exp->attribute("levels");
+				if (!lv || lv->get_type() != XT_ARRAY_STR)
+					return CERR_not_supported;
+				Rinteger *p = static_cast<Rinteger*>(exp.get());
+				const int *v = p->intArray();
+				size_t n = p->length();
+				ArrowArrayData *d = initArray(array, n, 2);
+				ArrowSchemaData *sd = initSchema(schema, "i", name);
+				buildValidity(array, d, n, [v](size_t i) { return v[i] == INT_MIN; });
+				// R codes are 1-based
+				d->ints.resize(n ? n : 1);
+				for (size_t i = 0; i < n; ++i)
+					d->ints[i] = (v[i] == INT_MIN) ? 0 : v[i] - 1;
+				d->buffers[1] = &d->ints[0];
+
+				d->dictionary = newArray();
+				sd->dictionary = newSchema();
+				exportStrings(*static_cast<Rstrings*>(lv.get()), NULL, d->dictionary, sd->dictionary);
+				array->dictionary = d->dictionary;
+				schema->dictionary = sd->dictionary;
+				return 0;
+			}
+
+			default:
+				return CERR_not_supported;
+		}
+	}
+
+	int exportArrow(const std::shared_ptr<Rexp>& exp, struct ArrowArray *array, struct ArrowSchema *schema)
+	{
+		if (!exp)
+			return CERR_not_supported;
+		std::shared_ptr<Rdataframe> df = Rdataframe::create(exp);
+		if (!df)
+			return exportColumn(exp, NULL, array, schema);
+
+		size_t nc = df->columns();
+		ArrowArrayData *d = initArray(array, df->rows(), 1);
+		ArrowSchemaData *sd = initSchema(schema, "+s", NULL);
+		schema->flags = 0;
+		for (size_t i = 0; i < nc; ++i)
+		{
+			d->children.push_back(newArray());
+			sd->children.push_back(newSchema());
+			const std::shared_ptr<Rexp>& col = df->column(i);
+			int res = col ? exportColumn(col, df->columnName(i), d->children.back(), sd->children.back()) : CERR_not_supported;
+			if (res)
+			{
+				array->release(array);
+				schema->release(schema);
+				return res;
+			}
+		}
+		array->n_children = (int64_t)nc;
+		array->children = nc ? &d->children[0] : NULL;
+		schema->n_children = (int64_t)nc;
+		schema->children = nc ? &sd->children[0] : NULL;
+		return 0;
+	}
+
+} // namespace Rconnection2
@@ -0,0 +1,103 @@
+/*
+ *  C++ Interface to Rserve - export to the Arrow C Data Interface
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+/* exportArrow() hands received vectors and data frames to Arrow consumers
+   through the C Data Interface (ArrowArray/ArrowSchema), without linking
+   Arrow itself:
+
+   integer   -> int32 ("i")          values zero-copy
+   double    -> float64 ("g")        values zero-copy
+   logical   -> boolean ("b")        values packed into a bitmap
+   character -> utf8 ("u")           offsets and characters copied
+   factor    -> dictionary of utf8   codes turned into 0-based int32 indices
+   data.frame-> struct ("+s")        one child per column
+
+   R's NA values (NA_INTEGER, NA_real_ - not other NaNs -, NA logicals and
+   strings) become validity bitmaps; none is allocated without NAs. The
+   zero-copy buffers point into the message buffer, which the exported
+   array keeps alive until its release callback is called. They are only
+   4-byte aligned where the QAP1 encoding puts them so.
+*/
+#pragma once
+
+#ifndef __RARROW_H__
+#define __RARROW_H__
+
+#include "Rconnection2.h"
+
+// the ABI-stable structs from the Arrow C Data Interface specification
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+extern "C" {
+
+struct ArrowSchema {
+	// Array type description
+	const char* format;
+	const char* name;
+	const char* metadata;
+	int64_t flags;
+	int64_t n_children;
+	struct ArrowSchema** children;
+	struct ArrowSchema* dictionary;
+
+	// Release callback
+	void (*release)(struct ArrowSchema*);
+	// Opaque producer-specific data
+	void* private_data;
+};
+
+struct ArrowArray {
+	// Array data description
+	int64_t length;
+	int64_t null_count;
+	int64_t offset;
+	int64_t n_buffers;
+	int64_t n_children;
+	const void** buffers;
+	struct ArrowArray** children;
+	struct ArrowArray* dictionary;
+
+	// Release callback
+	void (*release)(struct ArrowArray*);
+	// Opaque producer-specific data
+	void* private_data;
+};
+
+} // extern "C"
+
+#endif  // ARROW_C_DATA_INTERFACE
+
+namespace Rconnection2 {
+
+	/** exports exp - an integer, double, logical or character vector, a factor
+		or a data.frame of such columns - into array and schema. returns 0, after
+		which the caller owns both and has to call their release callbacks, or
+		CERR_not_supported (nothing to release then) */
+	RCONNECTION2_API int exportArrow(const std::shared_ptr<Rexp>& exp, struct ArrowArray *array,
+		struct ArrowSchema *schema);
+
+} // namespace Rconnection2
+
+#endif
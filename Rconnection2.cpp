@@ -40,16 +40,25 @@
    -10 - out of memory
    -11 - operation is unsupported (e.g. unix login while crypt is not linked)
    -12 - eval didn't return a SEXP (possibly the server is too old/buggy or crashed)
+   -13 - operation timed out
+   -14 - evaluation failed (see evalBatch)
+   -15 - result does not have the expected type or length (see evalInto)
+   -17 - no pooled connection became free in time (see RconnectionPool::checkout)
    */
 
 
 #include "Rconnection2.h"
+#include "Rswap.h"
 #include "sisocks.h"
 
 #ifdef unix
 #include <sys/un.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
 #else
+#include <io.h>
 #define AF_LOCAL -1
 #endif
 
@@ -65,6 +74,14 @@
 
 #include "Rsrv.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RSTRINGS_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
 #ifndef AF_LOCAL
 #define AF_LOCAL AF_UNIX
 #endif
@@ -90,10 +107,123 @@ template class RCONNECTION2_API std::weak_ptr<Rconnection2::Rexp>;
 
 namespace Rconnection2 {
 
+	// max. number of segments handed to the kernel in one gather call
+#define MAX_SEND_SEGMENTS 64
+#ifdef WIN32
+#define CONNECT_IN_PROGRESS (WSAGetLastError() == WSAEWOULDBLOCK)
+#else
+#define CONNECT_IN_PROGRESS (errno == EINPROGRESS)
+#endif
+
+	// messages at least this large count as bulk transfers for throughput measurements
+#define TUNE_BULK_MIN (256 * 1024)
+	// round trips with messages below this size estimate the RTT
+#define TUNE_SMALL_MAX 1024
+	// Rserve's send buffer unless changed through CMD_setBufferSize
+#define RSERVE_DEFAULT_BUFFER (2 * 1024 * 1024)
+
+	// default cap on the bytes of pipelined requests awaiting their reply
+#define PIPELINE_DEFAULT_LIMIT (1024 * 1024)
+
+	int IRconnection::sendSegments(const IoSegment *segs, int count)
+	{
+		SOCKET s = getSocket();
+		int i = 0;
+		size_t off = 0; // bytes of segs[i] already sent
+		while (i < count)
+		{
+			if (segs[i].len == off)
+			{
+				++i;
+				off = 0;
+				continue;
+			}
+#ifdef WIN32
+			WSABUF wb[MAX_SEND_SEGMENTS];
+			DWORD n = 0, sent = 0;
+			for (int k = i; k < count && n < MAX_SEND_SEGMENTS; ++k)
+			{
+				size_t skip = (k == i) ? off : 0;
+				wb[n].buf = (CHAR*)segs[k].data + skip;
+				wb[n].len = (ULONG)(segs[k].len - skip);
+				++n;
+			}
+			if (WSASend(s, wb, n, &sent, 0, NULL, NULL) == SOCKET_ERROR)
+				return CERR_send_error;
+			size_t w = sent;
+#else
+			struct iovec iov[MAX_SEND_SEGMENTS];
+			int n = 0;
+			for (int k = i; k < count && n < MAX_SEND_SEGMENTS; ++k)
+			{
+				size_t skip = (k == i) ? off : 0;
+				iov[n].iov_base = (char*)segs[k].data + skip;
+				iov[n].iov_len = segs[k].len - skip;
+				++n;
+			}
+			struct msghdr mh;
+			memset(&mh, 0, sizeof(mh));
+			mh.msg_iov = iov;
+			mh.msg_iovlen = n;
+#ifdef MSG_NOSIGNAL
+			ssize_t sent = sendmsg(s, &mh, MSG_NOSIGNAL);
+#else
+			ssize_t sent = sendmsg(s, &mh, 0);
+#endif
+			if (sent < 0)
+			{
+				if (errno == EINTR) continue;
+				return CERR_send_error;
+			}
+			size_t w = (size_t)sent;
+#endif
+			// advance past whatever the kernel accepted
+			while (w > 0)
+			{
+				size_t rest = segs[i].len - off;
+				if (w < rest)
+				{
+					off += w;
+					break;
+				}
+				w -= rest;
+				++i;
+				off = 0;
+			}
+		}
+		return 0;
+	}
+
+	int IRconnection::receive(void *buf, Rsize_t len)
+	{
+		SOCKET s = getSocket();
+		char *dp = (char*)buf;
+		while (len > 0)
+		{
+			int n = recv(s, dp, len, 0);
+			if (n == 0) return CERR_peer_closed;
+			if (n < 0)
+			{
+				if (sockerrno == EINTR) continue;
+				return CERR_io_error;
+			}
+			dp += n;
+			len -= n;
+		}
+		return 0;
+	}
+
 	Rmessage::Rmessage()
 		:
 		complete_(0),
-		len_(0)
+		len_(0),
+		rcvd_(0),
+		ext_(NULL),
+		ext_cap_(0),
+		ext_head_(0),
+		head_len_(0),
+		payload_ready_(false),
+		head_()
 	{
 		memset(&header_, 0, sizeof(header_));
 	}
@@ -101,7 +231,14 @@ namespace Rconnection2 {
 	Rmessage::Rmessage(int cmd)
 		:
 		complete_(1),
-		len_(0)
+		len_(0),
+		rcvd_(0),
+		ext_(NULL),
+		ext_cap_(0),
+		ext_head_(0),
+		head_len_(0),
+		payload_ready_(false),
+		head_()
 	{
 		memset(&header_, 0, sizeof(header_));
 		header_.cmd = cmd;
@@ -110,7 +247,14 @@ namespace Rconnection2 {
 	Rmessage::Rmessage(int cmd, const char *txt)
 		:
 		complete_(1),
-		len_(0)
+		len_(0),
+		rcvd_(0),
+		ext_(NULL),
+		ext_cap_(0),
+		ext_head_(0),
+		head_len_(0),
+		payload_ready_(false),
+		head_()
 	{
 		memset(&header_, 0, sizeof(header_));
 		int tl = strlen(txt) + 1;
@@ -128,7 +272,14 @@ namespace Rconnection2 {
 	Rmessage::Rmessage(int cmd, const void *buf, Rsize_t dlen, int raw_data)
 		:
 		complete_(1),
-		len_(0)
+		len_(0),
+		rcvd_(0),
+		ext_(NULL),
+		ext_cap_(0),
+		ext_head_(0),
+		head_len_(0),
+		payload_ready_(false),
+		head_()
 	{
 		memset(&header_, 0, sizeof(header_));
 		len_ = (raw_data) ? dlen : (dlen + 4);
@@ -143,7 +294,14 @@ namespace Rconnection2 {
 	Rmessage::Rmessage(int cmd, int i)
 		:
 		complete_(1),
-		len_(0)
+		len_(0),
+		rcvd_(0),
+		ext_(NULL),
+		ext_cap_(0),
+		ext_head_(0),
+		head_len_(0),
+		payload_ready_(false),
+		head_()
 	{
 		memset(&header_, 0, sizeof(header_));
 		len_ = 8; // DT_INT+len (4) + payload-1xINT (4)
@@ -156,13 +314,12 @@ namespace Rconnection2 {
 
 	int Rmessage::read(IRconnection& conn)
 	{
-		SOCKET s = conn.getSocket();
 		complete_ = 0;
-		int n = recv(s, (char*)&header_, sizeof(header_), 0);
-		if (n != sizeof(header_))
+		int n = conn.receive(&header_, sizeof(header_));
+		if (n)
 		{
 			conn.disconnect();
-			return (n == 0) ? -7 : -8;
+			return n;
 		}
 		Rsize_t i = len_ = header_.len = ptoi(header_.len);
 		header_.cmd = ptoi(header_.cmd);
@@ -174,28 +331,23 @@ namespace Rconnection2 {
 			int k = header_.dof;
 			while (k > 0)
 			{
-				n = recv(s, sb, (k > 256) ? 256 : k, 0);
-				if (n < 1)
+				n = conn.receive(sb, (k > 256) ? 256 : k);
+				if (n)
 				{
 					conn.disconnect();
-					return -8; // malformed packet
+					return n;
 				}
-				k -= n;
+				k -= (k > 256) ? 256 : k;
 			}
 		}
 		if (i > 0)
 		{
-			alloc_data_only(i);
-			char *dp = get_data();
-			while (i > 0 && (n = recv(s, dp, i, 0)) > 0)
-			{
-				dp += n;
-				i -= n;
-			}
-			if (i > 0)
+			alloc_received(i);
+			n = conn.receive(get_data(), i);
+			if (n)
 			{
 				conn.disconnect();
-				return -8;
+				return n;
 			}
 		}
 		parse();
@@ -203,10 +355,107 @@ namespace Rconnection2 {
 		return 0;
 	}
 
+	void Rmessage::begin_read()
+	{
+		complete_ = 0;
+		rcvd_ = 0;
+		len_ = 0;
+		head_len_ = 0;
+		payload_ready_ = false;
+		par_.clear();
+	}
+
+	void Rmessage::prepare_payload()
+	{
+		if (payload_ready_) return;
+		payload_ready_ = true;
+		// a payload that does not fit the caller's buffer gets its own
+		if (ext_ && (len_ > ext_cap_ + ext_head_ || (ext_head_ && len_ <= ext_cap_))) ext_ = NULL;
+		if (ext_) head_len_ = len_ - std::min(len_, ext_cap_);
+		if (len_ > 0 && !ext_) alloc_received(len_);
+	}
+
+	void Rmessage::check_read_complete()
+	{
+		if (rcvd_ < sizeof(header_) || rcvd_ < sizeof(header_) + (Rsize_t)header_.dof + len_)
+			return;
+		parse();
+		complete_ = 1;
+	}
+
+	size_t Rmessage::feed(const char *buf, size_t n)
+	{
+		size_t used = 0;
+		while (used < n && !complete_)
+		{
+			size_t k;
+			if (rcvd_ < sizeof(header_))
+			{
+				k = std::min(n - used, sizeof(header_) - rcvd_);
+				memcpy((char*)&header_ + rcvd_, buf + used, k);
+				rcvd_ += k;
+				if (rcvd_ == sizeof(header_))
+				{
+					len_ = header_.len = ptoi(header_.len);
+					header_.cmd = ptoi(header_.cmd);
+					header_.dof = ptoi(header_.dof);
+					header_.res = ptoi(header_.res);
+					if (header_.dof < 0) header_.dof = 0;
+					// the caller may pick the payload storage now (receive_into)
+					used += k;
+					check_read_complete();
+					break;
+				}
+			}
+			else if (rcvd_ < sizeof(header_) + (Rsize_t)header_.dof)
+			{
+				// skip past DOF
+				k = std::min(n - used, sizeof(header_) + header_.dof - rcvd_);
+				rcvd_ += k;
+			}
+			else
+			{
+				Rsize_t avail;
+				char *dp = read_window(avail);
+				k = std::min(n - used, (size_t)avail);
+				memcpy(dp, buf + used, k);
+				rcvd_ += k;
+			}
+			used += k;
+			check_read_complete();
+		}
+		return used;
+	}
+
+	char *Rmessage::read_window(Rsize_t& avail)
+	{
+		Rsize_t start = sizeof(header_) + header_.dof;
+		if (complete_ || rcvd_ < start)
+		{
+			avail = 0;
+			return NULL;
+		}
+		prepare_payload();
+		Rsize_t off = rcvd_ - start;
+		if (off < head_len_)
+		{
+			avail = head_len_ - off;
+			return (char*)head_ + off;
+		}
+		avail = len_ - off;
+		return get_data() + (off - head_len_);
+	}
+
+	void Rmessage::commit_read(Rsize_t n)
+	{
+		rcvd_ += n;
+		check_read_complete();
+	}
+
 	void Rmessage::parse()
 	{
 		par_.clear();
-		if (len_ < 4) return;
+		if (len_ < 4 || ext_) return; // raw payload in a caller's buffer
 		char *c = get_data(), *eop = c + len_;
 		while (c < eop)
 		{
@@ -231,23 +480,54 @@ namespace Rconnection2 {
 		}
 	}
 
+	// a RexpArena starts with room for ARENA_FIRST_NODES nodes of about
+	// ARENA_NODE_SIZE bytes (node plus control block), each further chunk
+	// is as large as all before it, up to ARENA_CHUNK_MAX
+#define ARENA_FIRST_NODES 16
+#define ARENA_NODE_SIZE 256
+#define ARENA_CHUNK_MAX (4 * 1024 * 1024)
+#define ARENA_ALIGN 16
+
+	RexpArena::~RexpArena()
+	{
+		for (char *c : chunks_)
+			::operator delete(c);
+	}
+
+	void RexpArena::enable()
+	{
+		enabled_ = true;
+		next_chunk_ = ARENA_FIRST_NODES * ARENA_NODE_SIZE;
+	}
+
+	void *RexpArena::allocate(size_t n)
+	{
+		n = (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+		std::lock_guard<std::mutex> lk(mtx_);
+		++allocs_;
+		if ((size_t)(end_ - cur_) < n)
+		{
+			size_t sz = std::max(next_chunk_, n);
+			char *c = (char*)::operator new(sz);
+			chunks_.push_back(c);
+			cur_ = c;
+			end_ = c + sz;
+			next_chunk_ = std::min(next_chunk_ * 2, (size_t)ARENA_CHUNK_MAX);
+		}
+		void *p = cur_;
+		cur_ += n;
+		return p;
+	}
+
 	int Rmessage::send(IRconnection& conn)
 	{
-		SOCKET s = conn.getSocket();
-		int failed = 0;
-		header_.cmd = itop(header_.cmd);
-		header_.len = itop(header_.len);
-		header_.dof = itop(header_.dof);
-		header_.res = itop(header_.res);
-		if (::send(s, (char*)&header_, sizeof(header_), 0) != sizeof(header_))
-			failed = -1;
-		if (!failed && len_ > 0 && (Rsize_t)::send(s, get_data(), len_, 0) != len_)
-			failed = -1;
-		header_.cmd = ptoi(header_.cmd);
-		header_.len = ptoi(header_.len);
-		header_.dof = ptoi(header_.dof);
-		header_.res = ptoi(header_.res);
-		return failed;
+		struct phdr ph;
+		ph.cmd = itop(header_.cmd);
+		ph.len = itop(header_.len);
+		ph.dof = itop(header_.dof);
+		ph.res = itop(header_.res);
+		IoSegment segs[2] = { { &ph, sizeof(ph) }, { get_data(), len_ } };
+		return conn.sendSegments(segs, (len_ > 0) ? 2 : 1) ? -1 : 0;
 	}
 
 	Rexp::Rexp(const std::shared_ptr<Rmessage>& msg) 
@@ -271,7 +551,7 @@ namespace Rconnection2 {
 		next_ = parseBytes(hp+hl);
 	}
 	
-	Rexp::Rexp(const unsigned int *pos, const std::shared_ptr<MessageBuffer>& buffer)
+	Rexp::Rexp(const unsigned int *pos, const std::shared_ptr<MessageBuffer>& buffer, bool lazy)
 	:
 		len_(0),
 		type_(-1),
@@ -282,7 +562,7 @@ namespace Rconnection2 {
 #ifdef DEBUG_CXX
 		std::cout << "new Rexp@" << static_cast<void*>(this) << std::endl;
 #endif
-		next_ = parseBytes(pos);
+		next_ = parseBytes(pos, lazy);
 	}
 
 	Rexp::Rexp(int type, const char *data, Rsize_t len, std::shared_ptr<Rexp> attr)
@@ -305,7 +585,7 @@ namespace Rconnection2 {
 		next_ = (char*)data + len_;
 	}
 
-	std::shared_ptr<Rexp> Rexp::create(const std::shared_ptr<Rmessage>& msg)
+	std::shared_ptr<Rexp> Rexp::create(const std::shared_ptr<Rmessage>& msg, bool lazy)
 	{
 		int hl = 1;
 		const unsigned int* d = msg->get_par(0);
@@ -316,10 +596,11 @@ namespace Rconnection2 {
 			plen |= ((Rsize_t)d[1]) << 24;
 		}
 
-		return createFromBytes(d + hl, msg->get_buffer());
+		return createFromBytes(d + hl, msg->get_buffer(), lazy);
 	}
 		
-	std::shared_ptr<Rexp> Rexp::createFromBytes(const unsigned int* d, const std::shared_ptr<MessageBuffer>& buffer)
+	std::shared_ptr<Rexp> Rexp::createFromBytes(const unsigned int* d, const std::shared_ptr<MessageBuffer>& buffer,
+		bool lazy)
 	{
 		int type = ptoi(*d) & 0x3f;
 
@@ -349,7 +630,7 @@ namespace Rconnection2 {
 
 			case XT_VECTOR:
 			{
-				auto p = Rvector::create(d, buffer);
+				auto p = Rvector::create(d, buffer, lazy);
 				expr = std::shared_ptr<Rexp>(p, static_cast<Rexp*>(p.get()));
 				break;
 			}
@@ -376,15 +657,40 @@ namespace Rconnection2 {
 				break;
 			}
 
+			case XT_ARRAY_BOOL:
+			{
+				auto p = Rlogical::create(d, buffer);
+				expr = std::shared_ptr<Rexp>(p, static_cast<Rexp*>(p.get()));
+				break;
+			}
+
+			case XT_RAW:
+			{
+				auto p = Rraw::create(d, buffer);
+				expr = std::shared_ptr<Rexp>(p, static_cast<Rexp*>(p.get()));
+				break;
+			}
+
+			case XT_ARRAY_CPLX:
+			{
+				auto p = Rcomplex::create(d, buffer);
+				expr = std::shared_ptr<Rexp>(p, static_cast<Rexp*>(p.get()));
+				break;
+			}
+
 			default:
 			{
 				if (IS_LIST_TYPE_(type))
 				{
-					auto p = Rlist::create(d, buffer);
+					auto p = Rlist::create(d, buffer, lazy);
 					expr = std::shared_ptr<Rexp>(p, static_cast<Rexp*>(p.get()));
 				}
 				else
-					expr = Rexp::createFromBytes(d, buffer);
+				{
+					// no specific class, raw payload only
+					RexpNodeMemory mem(sizeof(Rexp), buffer);
+					expr = adopt(new (mem.get()) Rexp(d, buffer, lazy), mem);
+				}
 				break;
 			}
 		}
@@ -392,7 +698,7 @@ namespace Rconnection2 {
 		return expr;
 	}
 
-	char *Rexp::parseBytes(const unsigned int *pos)
+	char *Rexp::parseBytes(const unsigned int *pos, bool lazy)
 	{
 		// plen is not used
 		int hl = 1;
@@ -408,7 +714,7 @@ namespace Rconnection2 {
 
 		if (p1&XT_HAS_ATTR)
 		{
-			attr_ = Rexp::createFromBytes((unsigned int*)data_, buffer_);
+			attr_ = Rexp::createFromBytes((unsigned int*)data_, buffer_, lazy);
 			len_ -= attr_->next_ - data_;
 			data_ = attr_->next_;
 		}
@@ -422,21 +728,51 @@ namespace Rconnection2 {
 		return data_ + len_;
 	}
 
-	void Rexp::store(char *buf) const
+	char *Rexp::skipBytes(const unsigned int *pos)
+	{
+		// the length includes the attributes
+		int hl = 1;
+		unsigned int p1 = ptoi(pos[0]);
+		Rsize_t len = p1 >> 8;
+		if ((p1&XT_LARGE) > 0)
+		{
+			hl++;
+			len |= ((Rsize_t)(ptoi(pos[1]))) << 24;
+		}
+		return (char*)(pos + hl) + len;
+	}
+
+	static int storeHeader(char *buf, int type, Rsize_t len)
 	{
 		int hl = 4;
 		unsigned int *i = (unsigned int*)buf;
-		i[0] = SET_PAR(type_, len_);
+		i[0] = SET_PAR(type, len);
 		i[0] = itop(i[0]);
-		if (len_ > 0x7fffff)
+		if (len > 0x7fffff)
 		{
 			buf[0] |= XT_LARGE;
-			i[1] = itop(len_ >> 24);
+			i[1] = itop(len >> 24);
 			hl += 4;
 		}
+		return hl;
+	}
+
+	void Rexp::store(char *buf) const
+	{
+		int hl = storeHeader(buf, type_, len_);
 		memcpy(buf + hl, data_, len_);
 	}
 
+	int Rexp::storeSegments(char *hdrbuf, IoSegment *segs) const
+	{
+		segs[0].data = hdrbuf;
+		segs[0].len = storeHeader(hdrbuf, type_, len_);
+		if (!len_) return 1;
+		segs[1].data = data_;
+		segs[1].len = len_;
+		return 2;
+	}
+
 	std::shared_ptr<Rexp> Rexp::attribute(const char *name) const
 	{
 		return (attr_ && IS_LIST_TYPE_(attr_->get_type())) ? static_cast<Rlist*>(attr_.get())->entryByTagName(name) : std::shared_ptr<Rexp>();
@@ -466,13 +802,7 @@ namespace Rconnection2 {
 	{
 		if (!data_) return;
 #ifdef SWAPEND
-		int *i = (int*) data_;
-		int *j = (int*) (data_+len_);
-		while (i<j)
-		{
-			*i=ptoi(*i);
-			i++;
-		}
+		swapBytes32(data_, len_ / 4);
 #endif
 	}
 
@@ -480,13 +810,7 @@ namespace Rconnection2 {
 	{
 		if (!data_) return;
 #ifdef SWAPEND
-		double *i = (double*) data_;
-		double *j = (double*) (data_+len_);
-		while (i<j)
-		{
-			*i=ptod(*i);
-			i++;
-		}
+		swapBytes64(data_, len_ / 8);
 #endif
 	}
 
@@ -504,6 +828,124 @@ namespace Rconnection2 {
 		return (((len) + 3L) & (rlen_max ^ 3L));
 	}
 
+	char *Rexp::initCounted(Rsize_t n, unsigned char pad)
+	{
+		len_ = 4 + align_length(n);
+		buffer_ = std::make_shared<MessageBuffer>(len_);
+		data_ = buffer_->get<char>();
+		next_ = NULL;
+		// the count stays in wire order, like in received payloads
+		*(unsigned int*)data_ = itop((unsigned int)n);
+		memset(data_ + 4 + n, pad, len_ - 4 - n);
+		return data_ + 4;
+	}
+
+	Rsize_t Rexp::countedLength() const
+	{
+		if (!data_ || len_ < 4) return 0;
+		Rsize_t n = ptoi(*(const unsigned int*)data_);
+		return (n > len_ - 4) ? 0 : n;
+	}
+
+	Rlogical::Rlogical(const unsigned char *values, int count)
+		:
+		Rexp(XT_ARRAY_BOOL),
+		count_(0)
+	{
+		// R pads logical vectors with 0xff
+		char *p = initCounted(count, 0xff);
+		if (count) memcpy(p, values, count);
+	}
+
+	Rlogical::Rlogical(const std::vector<bool>& values)
+		:
+		Rexp(XT_ARRAY_BOOL),
+		count_(0)
+	{
+		char *p = initCounted(values.size(), 0xff);
+		for (bool v : values)
+			*p++ = v ? 1 : 0;
+	}
+
+	void Rlogical::fix_content()
+	{
+		count_ = countedLength();
+	}
+
+	Rraw::Rraw(const void *data, Rsize_t n)
+		:
+		Rexp(XT_RAW),
+		count_(0),
+		bytes_(NULL),
+		external_()
+	{
+		char *p = initCounted(n, 0);
+		if (data && n) memcpy(p, data, n);
+	}
+
+	Rraw::Rraw(const std::shared_ptr<const void>& owner, const void *data, Rsize_t n)
+		:
+		Rexp(XT_RAW),
+		count_(n),
+		bytes_((unsigned char*)data),
+		external_(owner)
+	{
+		// no buffer, store() and storeSegments() put the count and padding around bytes_
+		len_ = 4 + align_length(n);
+	}
+
+	void Rraw::fix_content()
+	{
+		if (external_) return;
+		count_ = countedLength();
+		bytes_ = data_ ? (unsigned char*)data_ + 4 : NULL;
+	}
+
+	void Rraw::store(char *buf) const
+	{
+		if (!external_)
+		{
+			Rexp::store(buf);
+			return;
+		}
+		int hl = storeHeader(buf, type_, len_);
+		*(unsigned int*)(buf + hl) = itop((unsigned int)count_);
+		memcpy(buf + hl + 4, bytes_, count_);
+		memset(buf + hl + 4 + count_, 0, len_ - 4 - count_);
+	}
+
+	int Rraw::storeSegments(char *hdrbuf, IoSegment *segs) const
+	{
+		static const char padding[4] = { 0, 0, 0, 0 };
+
+		if (!external_)
+			return Rexp::storeSegments(hdrbuf, segs);
+		int hl = storeHeader(hdrbuf, type_, len_);
+		*(unsigned int*)(hdrbuf + hl) = itop((unsigned int)count_);
+		int n = 0;
+		segs[n].data = hdrbuf;
+		segs[n++].len = hl + 4;
+		if (count_)
+		{
+			segs[n].data = bytes_;
+			segs[n++].len = count_;
+		}
+		if (len_ - 4 > count_)
+		{
+			segs[n].data = padding;
+			segs[n++].len = len_ - 4 - count_;
+		}
+		return n;
+	}
+
+	void Rcomplex::fix_content()
+	{
+		if (!data_) return;
+#ifdef SWAPEND
+		swapBytes64(data_, len_ / 8);
+#endif
+	}
+
 	template<typename T>
 	static inline char* putValue(char* p, T v)
 	{
@@ -524,11 +966,23 @@ namespace Rconnection2 {
 	}
 
 	std::shared_ptr<Rstrings> Rstrings::create(const std::vector<std::string>& sv)
+	{
+		std::vector<const char*> pv;
+		pv.reserve(sv.size());
+		for (const auto& s : sv)
+			pv.push_back(s.c_str());
+		return create(pv);
+	}
+
+	// R sends NA as a lone 0xFF, a leading 0xFF of a string is escaped by another one
+#define NA_STRING_BYTE ((char)0xFF)
+
+	std::shared_ptr<Rstrings> Rstrings::create(const std::vector<const char*>& sv)
 	{
 		// compute required buffer length
 		Rsize_t len = 4, padding_len = 0; 
-		for (const auto& s : sv)
-			len += s.length() + 1 + ((!s.empty() && (unsigned char)s[0] == 0xFF) ? 1 : 0);
+		for (const char *s : sv)
+			len += s ? strlen(s) + 1 + ((*s == NA_STRING_BYTE) ? 1 : 0) : 2;
 		if (len > 0xfffff0) len += 4;
 		while (len & 3) { ++len; ++padding_len; }
 
@@ -546,32 +1000,78 @@ namespace Rconnection2 {
 		// put total length
 		char* p = putLength(p0, len);
 
-		for (const auto& s : sv)
+		for (const char *s : sv)
 		{
-			if (!s.empty() && (unsigned char)s[0] == 0xFF) *p++ = (char)0xFF;
-			strcpy(p, s.c_str());
-			p += s.length() + 1;
+			if (!s)
+			{
+				*p++ = NA_STRING_BYTE;
+				*p++ = 0;
+				continue;
+			}
+			if (*s == NA_STRING_BYTE) *p++ = NA_STRING_BYTE;
+			size_t sl = strlen(s) + 1;
+			memcpy(p, s, sl);
+			p += sl;
 		}
         for (Rsize_t k = 0; k < padding_len; ++k) *p++ = 1;
 
 		return create(buffer->get<unsigned int>(), buffer);
 	}
 
+	static inline unsigned int lowestBit(unsigned int mask)
+	{
+#ifdef _MSC_VER
+		unsigned long i;
+		_BitScanForward(&i, mask);
+		return (unsigned int)i;
+#else
+		return (unsigned int)__builtin_ctz(mask);
+#endif
+	}
+
+	void Rstrings::addString(const char *c, const char *z)
+	{
+		if (*c == NA_STRING_BYTE)
+		{
+			if (z == c + 1)
+			{
+				cont_.push_back(NULL);
+				lens_.push_back(0);
+				return;
+			}
+			++c;
+		}
+		cont_.push_back(c);
+		lens_.push_back((Rsize_t)(z - c));
+	}
+
 	void Rstrings::fix_content()
 	{
 		cont_.clear();
-		char *c = data_;
-		unsigned i = 0;
-		while (i < len_)
+		lens_.clear();
+		const char *c = data_, *p = data_, *eod = data_ + len_;
+#ifdef RSTRINGS_SSE2
+		// 16 bytes at a time, every set bit of the mask is a terminator
+		const __m128i zero = _mm_setzero_si128();
+		for (; p + 16 <= eod; p += 16)
 		{
-			char* p = c;
-			while (*c && i < len_) ++c, ++i;
-			if (i < len_)
+			unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), zero));
+			while (mask)
 			{
-				cont_.push_back(p);
-				++c; ++i;
+				const char *z = p + lowestBit(mask);
+				addString(c, z);
+				c = z + 1;
+				mask &= mask - 1;
 			}
 		}
+#endif
+		while (c < eod)
+		{
+			const char *z = (const char*)memchr(p, 0, eod - p);
+			if (!z) break; // padding
+			addString(c, z);
+			c = p = z + 1;
+		}
 	}
 
 	void Rlist::fix_content()
@@ -581,7 +1081,14 @@ namespace Rconnection2 {
 #ifdef DEBUG_CXX
 		std::cout << "Rlist::fix_content data_=" <<  (void*) ptr <<", type=" << type_ <<"\n";
 #endif
-		if (type_ == XT_LIST)
+		if (lazy_ && (type_ == XT_LIST_NOTAG || type_ == XT_LIST_TAG))
+		{
+			/* only note where the first entry is, the rest follows on access */
+			eod_ = eod;
+			if (ptr < eod)
+				setLazyEntry(ptr);
+		}
+		else if (type_ == XT_LIST)
 		{
 			/* old-style lists */
 			head_ = Rexp::createFromBytes((unsigned int*)ptr, buffer_);
@@ -612,7 +1119,8 @@ namespace Rconnection2 {
 				if (!h) break;
 				if (n)
 				{
-					static_cast<Rlist*>(lt.get())->tail_.reset((Rexp*)new Rlist(type_, h, 0, h->get_next()));
+					RexpNodeMemory mem(sizeof(Rlist), buffer_);
+					static_cast<Rlist*>(lt.get())->tail_ = adopt<Rexp>(new (mem.get()) Rlist(type_, h, 0, h->get_next()), mem);
 					lt = static_cast<Rlist*>(lt.get())->tail_;
 				}
 				else
@@ -642,7 +1150,8 @@ namespace Rconnection2 {
 				if (!t) break;
 				if (n)
 				{
-					static_cast<Rlist*>(lt.get())->tail_.reset((Rexp*)new Rlist(type_, h, t, t->get_next()));
+					RexpNodeMemory mem(sizeof(Rlist), buffer_);
+					static_cast<Rlist*>(lt.get())->tail_ = adopt<Rexp>(new (mem.get()) Rlist(type_, h, t, t->get_next()), mem);
 					lt = static_cast<Rlist*>(lt.get())->tail_;
 				}
 				else
@@ -660,10 +1169,54 @@ namespace Rconnection2 {
 #endif
 	}
 
+	char *Rlist::setLazyEntry(char *ptr)
+	{
+		head_pos_.store((const unsigned int*)ptr, std::memory_order_relaxed);
+		ptr = skipBytes((const unsigned int*)ptr);
+		if (type_ == XT_LIST_TAG && ptr < eod_)
+		{
+			tag_pos_.store((const unsigned int*)ptr, std::memory_order_relaxed);
+			ptr = skipBytes((const unsigned int*)ptr);
+		}
+		tail_pos_.store((ptr < eod_) ? ptr : NULL, std::memory_order_relaxed);
+		return ptr;
+	}
+
+	/* readers check the position without the lock, so it is cleared only
+	   after the part is stored - seeing NULL means the part can be read */
+	void Rlist::loadHead() const
+	{
+		std::lock_guard<std::mutex> lk(buffer_->decode_mutex());
+		const unsigned int *pos = head_pos_.load(std::memory_order_relaxed);
+		if (!pos) return; // another thread was first
+		head_ = Rexp::createFromBytes(pos, buffer_, true);
+		head_pos_.store(NULL, std::memory_order_release);
+	}
+
+	void Rlist::loadTag() const
+	{
+		std::lock_guard<std::mutex> lk(buffer_->decode_mutex());
+		const unsigned int *pos = tag_pos_.load(std::memory_order_relaxed);
+		if (!pos) return;
+		tag_ = Rexp::createFromBytes(pos, buffer_, true);
+		tag_pos_.store(NULL, std::memory_order_release);
+	}
+
+	void Rlist::loadTail() const
+	{
+		std::lock_guard<std::mutex> lk(buffer_->decode_mutex());
+		char *pos = tail_pos_.load(std::memory_order_relaxed);
+		if (!pos) return;
+		RexpNodeMemory mem(sizeof(Rlist), buffer_);
+		tail_ = adopt<Rexp>(new (mem.get()) Rlist(type_, pos, eod_, buffer_), mem);
+		tail_pos_.store(NULL, std::memory_order_release);
+	}
+
 	const std::vector<std::string>& Rvector::strings()
 	{
 		if (!strs_populated_)
 		{
+			loadAll();
 			for (const auto& p : cont_)
 			{
 				if (p->get_type() == XT_STR)
@@ -676,52 +1229,160 @@ namespace Rconnection2 {
 
 	size_t Rvector::indexOf(const std::shared_ptr<Rexp>& exp) const
 	{
+		loadAll();
 		auto it = std::find(cont_.begin(), cont_.end(), exp);
 		return it == cont_.end() ? std::string::npos : std::distance(cont_.begin(), it);
 	}
 
+	// shorter objects are searched linearly, that is faster than hashing them
+#define NAME_INDEX_MIN 16
+
 	size_t Rvector::indexOfString(const char *str) const
 	{
-		size_t i = 0;
-		for (const auto& p : cont_)
+		size_t n = cont_.size();
+		if (n >= NAME_INDEX_MIN)
+		{
+			std::call_once(index_once_, [this, n]()
+			{
+				index_.reset(new RnameIndex());
+				index_->reserve(n);
+				for (size_t i = 0; i < n; ++i)
+				{
+					const std::shared_ptr<Rexp>& p = element(i);
+					if (p && p->get_type() == XT_STR)
+						index_->add(((Rstring*)p.get())->c_str(), i);
+				}
+			});
+			return index_->find(str);
+		}
+		for (size_t i = 0; i < n; ++i)
 		{
+			const std::shared_ptr<Rexp>& p = element(i);
 			if (p && p->get_type() == XT_STR && !strcmp(((Rstring*)p.get())->c_str(), str))
 				return i;
-			++i;
 		}
 		return std::string::npos;
 	}
 
-	int Rstrings::indexOfString(const char *str)
+	int Rstrings::indexOfString(const char *str) const
 	{
-		for (size_t i = 0, n = cont_.size(); i < n; ++i)
-			if (!strcmp(cont_[i], str)) return i;
+		size_t n = cont_.size();
+		if (n >= NAME_INDEX_MIN)
+		{
+			std::call_once(index_once_, [this, n]()
+			{
+				index_.reset(new RnameIndex());
+				index_->reserve(n);
+				for (size_t i = 0; i < n; ++i)
+					if (cont_[i]) index_->add(cont_[i], lens_[i], i);
+			});
+			size_t pos = index_->find(str);
+			return pos == std::string::npos ? -1 : (int)pos;
+		}
+		for (size_t i = 0; i < n; ++i)
+			if (cont_[i] && !strcmp(cont_[i], str)) return i;
 		return -1;
 	}
 
+	const char *Rlist::tagName(const std::shared_ptr<Rexp>& tag)
+	{
+		return (tag && IS_SYMBOL_TYPE_(tag->get_type())) ? static_cast<Rsymbol*>(tag.get())->symbolName() : NULL;
+	}
 
-	void Rvector::fix_content()
+	void Rlist::buildIndex() const
 	{
-		char *ptr = data_;
-		char *eod = data_ + len_;
-		cont_.clear();
-		while (ptr < eod)
+		std::vector<const Rlist*> nodes;
+		for (const Rlist *l = this; l; )
 		{
-			cont_.push_back(Rexp::createFromBytes((unsigned int*)ptr, buffer_));
-			if (cont_.back())
-				ptr = cont_.back()->get_next();
-			else
-				break;
+			nodes.push_back(l);
+			std::shared_ptr<Rexp> tail = l->get_tail();
+			l = static_cast<const Rlist*>(tail.get());
 		}
+		if (nodes.size() < NAME_INDEX_MIN) return;
+		index_.reset(new RnameIndex());
+		index_->reserve(nodes.size());
+		for (size_t i = 0; i < nodes.size(); ++i)
+		{
+			// the symbols are owned by the nodes, so the keys stay valid
+			const char *name = tagName(nodes[i]->get_tag());
+			if (name) index_->add(name, i);
+		}
+		index_nodes_.swap(nodes);
 	}
 
-	std::shared_ptr<Rexp> Rvector::byName_Rexp(const char *name) const
+	std::shared_ptr<Rexp> Rlist::entryByTagName(const char *name) const
 	{
-		/* here we are not using IS_LIST_TYPE_() because XT_LIST_NOTAG is guaranteed to not match */
-		if (cont_.empty() || !attr_ || (attr_->get_type() != XT_LIST && attr_->get_type() != XT_LIST_TAG))
-			return std::shared_ptr<Rexp>();
-
-		std::shared_ptr<Rexp> e = ((Rlist*)attr_.get())->get_head();
+		std::call_once(index_once_, [this]() { buildIndex(); });
+		if (index_)
+		{
+			size_t pos = index_->find(name);
+			return pos == std::string::npos ? std::shared_ptr<Rexp>() : index_nodes_[pos]->get_head();
+		}
+		for (const Rlist *l = this; l; )
+		{
+			const char *t = tagName(l->get_tag());
+			if (t && !strcmp(t, name))
+				return l->get_head();
+			std::shared_ptr<Rexp> tail = l->get_tail();
+			l = static_cast<const Rlist*>(tail.get());
+		}
+		return std::shared_ptr<Rexp>();
+	}
+
+	void Rvector::fix_content()
+	{
+		char *ptr = data_;
+		char *eod = data_ + len_;
+		cont_.clear();
+		if (lazy_)
+		{
+			/* record the positions only, element() creates them */
+			std::vector<const unsigned int*> pos;
+			while (ptr < eod)
+			{
+				pos.push_back((const unsigned int*)ptr);
+				ptr = skipBytes((const unsigned int*)ptr);
+			}
+			std::vector< std::atomic<const unsigned int*> > slots(pos.size());
+			for (size_t i = 0; i < pos.size(); ++i)
+				slots[i].store(pos[i], std::memory_order_relaxed);
+			lazy_pos_.swap(slots);
+			cont_.resize(pos.size());
+			return;
+		}
+		while (ptr < eod)
+		{
+			cont_.push_back(Rexp::createFromBytes((unsigned int*)ptr, buffer_));
+			if (cont_.back())
+				ptr = cont_.back()->get_next();
+			else
+				break;
+		}
+	}
+
+	// locked like Rlist::loadHead()
+	void Rvector::loadElement(size_t i) const
+	{
+		std::lock_guard<std::mutex> lk(buffer_->decode_mutex());
+		const unsigned int *pos = lazy_pos_[i].load(std::memory_order_relaxed);
+		if (!pos) return;
+		cont_[i] = Rexp::createFromBytes(pos, buffer_, true);
+		lazy_pos_[i].store(NULL, std::memory_order_release);
+	}
+
+	void Rvector::loadAll() const
+	{
+		for (size_t i = 0; i < lazy_pos_.size(); ++i)
+			if (lazy_pos_[i].load(std::memory_order_acquire)) loadElement(i);
+	}
+
+	std::shared_ptr<Rexp> Rvector::byName_Rexp(const char *name) const
+	{
+		/* here we are not using IS_LIST_TYPE_() because XT_LIST_NOTAG is guaranteed to not match */
+		if (cont_.empty() || !attr_ || (attr_->get_type() != XT_LIST && attr_->get_type() != XT_LIST_TAG))
+			return std::shared_ptr<Rexp>();
+
+		std::shared_ptr<Rexp> e = ((Rlist*)attr_.get())->get_head();
 		if (((Rlist*)attr_.get())->get_tag())
 			e = ((Rlist*)attr_.get())->entryByTagName("names");
 		if (!e || (e->get_type() != XT_VECTOR && e->get_type() != XT_ARRAY_STR && e->get_type() != XT_STR))
@@ -729,31 +1390,410 @@ namespace Rconnection2 {
 		if (e->get_type() == XT_VECTOR)
 		{
 			size_t pos = ((Rvector*)e.get())->indexOfString(name);
-			if (pos != std::string::npos && pos < cont_.size()) return cont_[pos];
+			if (pos != std::string::npos && pos < cont_.size()) return element(pos);
 		}
 		else if (e->get_type() == XT_ARRAY_STR)
 		{
 			size_t pos = ((Rstrings*)e.get())->indexOfString(name);
-			if (pos != std::string::npos && pos < cont_.size()) return cont_[pos];
+			if (pos != std::string::npos && pos < cont_.size()) return element(pos);
 		}
 		else
 		{
 			if (!strcmp(((Rstring*)e.get())->c_str(), name))
-				return cont_[0];
+				return element(0);
 		}
 		return std::shared_ptr<Rexp>();
 	}
 
+	// read-ahead buffer size and the payload size from which we receive in place
+#define RECV_BUFFER_SIZE 65536
+#define RECV_DIRECT_MIN (RECV_BUFFER_SIZE / 2)
+	// outgoing segments up to this size are copied into the frame
+#define INLINE_SEGMENT_MAX 256
+
+	Rprotocol::Rprotocol(bool expect_id)
+		:
+		state_(st_handshake),
+		error_(0),
+		auth_(0),
+		idlen_(0),
+		rbuf_(),
+		area_(area_none),
+		inmsg_(),
+		sinks_(),
+		received_(),
+		outq_(),
+		out_off_(0),
+		out_locked_(0),
+		on_oob_send_(),
+		on_oob_msg_()
+	{
+		reset(expect_id);
+	}
+
+	void Rprotocol::reset(bool expect_id)
+	{
+		state_ = expect_id ? st_handshake : st_ready;
+		error_ = 0;
+		auth_ = 0;
+		salt_[0] = '.';
+		salt_[1] = '.';
+		idlen_ = 0;
+		area_ = area_none;
+		inmsg_.reset();
+		sinks_.clear();
+		received_.clear();
+		outq_.clear();
+		out_off_ = 0;
+		out_locked_ = 0;
+	}
+
+	int Rprotocol::setError(int err)
+	{
+		state_ = st_failed;
+		error_ = err;
+		return err;
+	}
+
+	char *Rprotocol::readBuffer(size_t& avail)
+	{
+		if (state_ == st_failed)
+		{
+			area_ = area_none;
+			avail = 0;
+			return NULL;
+		}
+		if (state_ == st_handshake)
+		{
+			// exactly the ID string, whatever follows belongs to a message
+			area_ = area_id;
+			avail = sizeof(idbuf_) - idlen_;
+			return idbuf_ + idlen_;
+		}
+		if (inmsg_)
+		{
+			Rsize_t w;
+			char *p = inmsg_->read_window(w);
+			if (p && w >= RECV_DIRECT_MIN)
+			{
+				area_ = area_message;
+				avail = w;
+				return p;
+			}
+		}
+		if (rbuf_.empty()) rbuf_.resize(RECV_BUFFER_SIZE);
+		area_ = area_buffer;
+		avail = rbuf_.size();
+		return &rbuf_[0];
+	}
+
+	int Rprotocol::commitRead(size_t n)
+	{
+		Area a = area_;
+		area_ = area_none;
+		switch (a)
+		{
+			case area_id:
+				idlen_ += n;
+				if (idlen_ == sizeof(idbuf_))
+				{
+					int res = parseIDstring(idbuf_, &auth_, salt_);
+					if (res) return setError(res);
+					state_ = st_ready;
+				}
+				return 0;
+
+			case area_message:
+				inmsg_->commit_read(n);
+				if (inmsg_->is_complete())
+				{
+					std::shared_ptr<Rmessage> msg;
+					msg.swap(inmsg_);
+					return deliver(msg);
+				}
+				return 0;
+
+			case area_buffer:
+				return feed(&rbuf_[0], n);
+
+			default:
+				return (state_ == st_failed) ? error_ : 0;
+		}
+	}
+
+	std::shared_ptr<Rmessage> Rprotocol::inPlaceTarget() const
+	{
+		if (state_ != st_ready || !inmsg_) return std::shared_ptr<Rmessage>();
+		Rsize_t w;
+		char *p = inmsg_->read_window(w);
+		return (p && w >= RECV_DIRECT_MIN) ? inmsg_ : std::shared_ptr<Rmessage>();
+	}
+
+	// replies to requests, as opposed to OOB frames R sends on its own
+	static inline bool isReply(int cmd)
+	{
+		return (cmd & CMD_RESP) && !(cmd & CMD_OOB);
+	}
+
+	int Rprotocol::feed(const char *buf, size_t n)
+	{
+		while (n > 0)
+		{
+			if (state_ == st_failed) return error_;
+			if (state_ == st_handshake)
+			{
+				size_t k = std::min(n, sizeof(idbuf_) - idlen_);
+				memcpy(idbuf_ + idlen_, buf, k);
+				area_ = area_id;
+				int res = commitRead(k);
+				if (res) return res;
+				buf += k;
+				n -= k;
+				continue;
+			}
+			if (!inmsg_)
+			{
+				inmsg_ = Rmessage::create();
+				inmsg_->begin_read();
+			}
+			bool had_header = inmsg_->has_header();
+			size_t k = inmsg_->feed(buf, n);
+			buf += k;
+			n -= k;
+			// sinks belong to replies, OOB frames in between must not take them
+			if (!had_header && inmsg_->has_header() && !sinks_.empty() && isReply(inmsg_->get_header().cmd))
+			{
+				if (!inmsg_->is_complete())
+					inmsg_->receive_into(sinks_.front().buf, sinks_.front().cap, sinks_.front().head);
+				sinks_.pop_front();
+			}
+			if (inmsg_->is_complete())
+			{
+				std::shared_ptr<Rmessage> msg;
+				msg.swap(inmsg_);
+				int res = deliver(msg);
+				if (res) return res;
+			}
+		}
+		return 0;
+	}
+
+	int Rprotocol::deliver(const std::shared_ptr<Rmessage>& msg)
+	{
+		int cmd = msg->command();
+		if (!IS_OOB_SEND(cmd) && !IS_OOB_MSG(cmd))
+		{
+			received_.push_back(msg);
+			return 0;
+		}
+
+		int status;
+		std::shared_ptr<Rexp> exp = decodeSEXPResponse(msg, &status);
+		if (IS_OOB_SEND(cmd))
+		{
+			if (on_oob_send_) on_oob_send_(OOB_USR_CODE(cmd), exp);
+			return 0;
+		}
+
+		// OOB_MSG - R blocks until it reads the answer
+		if (!on_oob_msg_)
+			return append(RESP_ERR, NULL, 0, NULL, 0, std::shared_ptr<const void>(), true);
+		std::shared_ptr<Rexp> answer = on_oob_msg_(OOB_USR_CODE(cmd), exp);
+		if (!answer)
+			return append(RESP_OK, NULL, 0, NULL, 0, std::shared_ptr<const void>(), true);
+		return appendSEXP(RESP_OK, *answer, answer, true);
+	}
+
+	std::shared_ptr<Rmessage> Rprotocol::nextMessage()
+	{
+		std::shared_ptr<Rmessage> msg;
+		if (!received_.empty())
+		{
+			msg = received_.front();
+			received_.pop_front();
+		}
+		return msg;
+	}
+
+	int Rprotocol::encode(int cmd, const IoSegment *segs, int count, const std::shared_ptr<const void>& owner)
+	{
+		return append(cmd, NULL, 0, segs, count, owner);
+	}
+
+	int Rprotocol::append(int cmd, const char *head, size_t hlen, const IoSegment *segs, int count,
+		const std::shared_ptr<const void>& owner, bool urgent)
+	{
+		if (state_ == st_failed) return error_;
+		uint64_t len = hlen;
+		for (int i = 0; i < count; ++i)
+			len += segs[i].len;
+		struct phdr ph;
+		memset(&ph, 0, sizeof(ph));
+		ph.cmd = itop(cmd);
+		ph.len = itop((unsigned int)(len & 0xffffffff));
+		ph.res = itop((unsigned int)(len >> 32));
+
+		std::deque<Outgoing>::iterator it = outq_.end();
+		if (urgent)
+		{
+			// must not split a frame that is half way out
+			size_t started = out_off_ + out_locked_;
+			it = outq_.begin();
+			while (it != outq_.end() && started > 0)
+			{
+				started = (started > it->total) ? started - it->total : 0;
+				++it;
+			}
+		}
+		Outgoing& o = *outq_.insert(it, Outgoing());
+		o.owner = owner;
+		o.total = sizeof(ph) + len;
+		appendPiece(o, (const char*)&ph, sizeof(ph), true);
+		if (hlen) appendPiece(o, head, hlen, true);
+		for (int i = 0; i < count; ++i)
+			appendPiece(o, (const char*)segs[i].data, segs[i].len, segs[i].len <= INLINE_SEGMENT_MAX);
+		return 0;
+	}
+
+	void Rprotocol::appendPiece(Outgoing& o, const char *data, size_t len, bool copy)
+	{
+		if (!len) return;
+		if (!copy)
+		{
+			Piece p = { data, 0, len };
+			o.pieces.push_back(p);
+			return;
+		}
+		if (!o.pieces.empty() && !o.pieces.back().ext)
+			o.pieces.back().len += len; // inline pieces are always contiguous
+		else
+		{
+			Piece p = { NULL, o.inline_.size(), len };
+			o.pieces.push_back(p);
+		}
+		o.inline_.insert(o.inline_.end(), data, data + len);
+	}
+
+	int Rprotocol::encode(const Rmessage& msg, const std::shared_ptr<const void>& owner)
+	{
+		IoSegment seg = { msg.get_data(), msg.get_len() };
+		return encode(msg.get_header().cmd, &seg, (seg.len > 0) ? 1 : 0, owner);
+	}
+
+	int Rprotocol::encodeAssign(const char *symbol, const Rexp& exp, const std::shared_ptr<const void>& owner)
+	{
+		// only the parameter headers are built here, the SEXP payload is
+		// referenced straight from the Rexp's own buffer
+		int tl = strlen(symbol) + 1;
+		if (tl & 3) tl = (tl + 4) & 0xfffc;
+		Rsize_t xl = exp.storageSize();
+		Rsize_t hl = 4 + tl + 4;
+		if (xl > 0x7fffff) hl += 4;
+		std::vector<unsigned int> hdr((hl + 12) / 4, 0);
+		char *hp = (char*)&hdr[0];
+		((unsigned int*)hp)[0] = itop(SET_PAR(DT_STRING, tl));
+		strcpy(hp + 4, symbol);
+		((unsigned int*)(hp + 4 + tl))[0] = itop(SET_PAR((Rsize_t)((xl > 0x7fffff) ? (DT_SEXP | DT_LARGE) : DT_SEXP), (Rsize_t)xl));
+		if (xl > 0x7fffff)
+			((unsigned int*)(hp + 4 + tl))[1] = itop(xl >> 24);
+
+		// the SEXP header is written right behind the parameter headers
+		IoSegment segs[3];
+		int n = exp.storeSegments(hp + hl, segs);
+		return append(CMD_setSEXP, hp, hl + segs[0].len, segs + 1, n - 1, owner);
+	}
+
+	int Rprotocol::appendSEXP(int cmd, const Rexp& exp, const std::shared_ptr<const void>& owner, bool urgent)
+	{
+		Rsize_t xl = exp.storageSize();
+		size_t hl = (xl > 0x7fffff) ? 8 : 4;
+		unsigned int hdr[5]; // DT_SEXP header followed by the SEXP header
+		hdr[0] = itop(SET_PAR((Rsize_t)((xl > 0x7fffff) ? (DT_SEXP | DT_LARGE) : DT_SEXP), (Rsize_t)xl));
+		if (hl > 4)
+			hdr[1] = itop(xl >> 24);
+		IoSegment segs[3];
+		int n = exp.storeSegments((char*)hdr + hl, segs);
+		return append(cmd, (const char*)hdr, hl + segs[0].len, segs + 1, n - 1, owner, urgent);
+	}
+
+	size_t Rprotocol::outputSize() const
+	{
+		size_t n = 0;
+		for (const auto& o : outq_)
+			n += o.total;
+		return n - out_off_;
+	}
+
+	int Rprotocol::pendingOutput(IoSegment *segs, int max) const
+	{
+		int n = 0;
+		size_t skip = out_off_;
+		for (auto it = outq_.begin(); it != outq_.end() && n < max; ++it)
+		{
+			for (const auto& p : it->pieces)
+			{
+				if (skip >= p.len)
+				{
+					skip -= p.len;
+					continue;
+				}
+				if (n == max) break;
+				const char *base = p.ext ? p.ext : &it->inline_[p.off];
+				segs[n].data = base + skip;
+				segs[n].len = p.len - skip;
+				skip = 0;
+				++n;
+			}
+		}
+		return n;
+	}
+
+	void Rprotocol::consumeOutput(size_t n)
+	{
+		out_locked_ = (n < out_locked_) ? out_locked_ - n : 0;
+		while (n > 0 && !outq_.empty())
+		{
+			size_t rest = outq_.front().total - out_off_;
+			if (n < rest)
+			{
+				out_off_ += n;
+				return;
+			}
+			n -= rest;
+			out_off_ = 0;
+			outq_.pop_front();
+		}
+	}
+
 	Rconnection::Rconnection(const char *host, int port)
 		:
 		host_(host),
 		port_(port),
 		family_((port == -1) ? AF_LOCAL : AF_INET),
 		s_(-1),
-		auth_(0)
+		auth_(0),
+		proto_(),
+		piped_(),
+		piped_bytes_(0),
+		pipe_limit_(PIPELINE_DEFAULT_LIMIT),
+		pipe_holding_(false),
+		pipe_admitted_(0),
+		pipe_done_(0),
+		pumping_(false),
+		timeout_ms_(-1),
+		connect_timeout_ms_(-1),
+		deadline_(),
+		deadline_set_(false),
+		topt_(),
+		tstats_(),
+		server_buffer_asked_(0),
+		sndbuf_asked_(0),
+		rcvbuf_asked_(0),
+		rtt_min_us_(0)
 	{
 		salt_[0] = '.';
 		salt_[1] = '.';
+		memset(&tstats_, 0, sizeof(tstats_));
 	}
 
 	Rconnection::Rconnection(const Rsession& session)
@@ -767,17 +1807,70 @@ namespace Rconnection2 {
 		auth_ = 0;
 		salt_[0] = '.';
 		salt_[1] = '.';
+		piped_bytes_ = 0;
+		pipe_limit_ = PIPELINE_DEFAULT_LIMIT;
+		pipe_holding_ = false;
+		pipe_admitted_ = 0;
+		pipe_done_ = 0;
+		pumping_ = false;
+		timeout_ms_ = -1;
+		connect_timeout_ms_ = -1;
+		deadline_set_ = false;
+		server_buffer_asked_ = 0;
+		sndbuf_asked_ = 0;
+		rcvbuf_asked_ = 0;
+		rtt_min_us_ = 0;
+		memset(&tstats_, 0, sizeof(tstats_));
 		session_key_.resize(32);
 		memcpy(&session_key_[0], session.key(), 32);
 	}
 
+	/** waits until s is readable and/or writable, timeout_ms = -1 waits forever.
+		returns 0, CERR_timeout or CERR_io_error */
+	static int waitSocket(SOCKET s, bool for_read, bool for_write, int timeout_ms, bool& readable, bool& writable)
+	{
+#ifdef WIN32
+		WSAPOLLFD pfd;
+		pfd.fd = s;
+		pfd.events = (for_read ? POLLRDNORM : 0) | (for_write ? POLLWRNORM : 0);
+		pfd.revents = 0;
+		int n = WSAPoll(&pfd, 1, timeout_ms);
+#else
+		struct pollfd pfd;
+		pfd.fd = s;
+		pfd.events = (for_read ? POLLIN : 0) | (for_write ? POLLOUT : 0);
+		pfd.revents = 0;
+		int n;
+		do
+			n = poll(&pfd, 1, timeout_ms);
+		while (n < 0 && errno == EINTR);
+#endif
+		if (n < 0) return CERR_io_error;
+		if (n == 0) return CERR_timeout;
+		// errors and hang-ups are reported by the following recv()/send()
+		readable = for_read && (pfd.revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+		writable = for_write && (pfd.revents & (POLLOUT | POLLHUP | POLLERR)) != 0;
+		return 0;
+	}
+
+	static void setNonBlocking(SOCKET s, bool on)
+	{
+#ifdef WIN32
+		u_long mode = on ? 1 : 0;
+		ioctlsocket(s, FIONBIO, &mode);
+#else
+		int fl = fcntl(s, F_GETFL, 0);
+		if (fl != -1)
+			fcntl(s, F_SETFL, on ? (fl | O_NONBLOCK) : (fl & ~O_NONBLOCK));
+#endif
+	}
+
 	int Rconnection::connect()
 	{
 #ifdef unix
 		struct sockaddr_un sau;
 #endif
 		SAIN sai;
-		char IDstring[33];
 
 		if (family_ == AF_INET)
 		{
@@ -795,91 +1888,550 @@ namespace Rconnection2 {
 #endif
 		}
 
-		IDstring[32] = 0;
-		int i;
-
-		s_ = socket(family_, SOCK_STREAM, 0);
-		if (family_ == AF_INET)
+		int i;
+
+		startDeadline(connect_timeout_ms_);
+		s_ = socket(family_, SOCK_STREAM, 0);
+		// with a deadline the connect itself is non-blocking
+		if (deadline_set_) setNonBlocking(s_, true);
+		server_buffer_asked_ = 0;
+		tstats_.server_buffer = 0;
+		sndbuf_asked_ = rcvbuf_asked_ = 0;
+		applySocketBuffers(topt_.sndbuf, topt_.rcvbuf);
+		if (family_ == AF_INET)
+		{
+#ifdef CAN_TCP_NODELAY
+			int opt = 1;
+			setsockopt(s_, IPPROTO_TCP, TCP_NODELAY, (const char*) &opt, sizeof(opt));
+#endif
+			i = ::connect(s_, (SA*)&sai, sizeof(sai));
+		}
+#ifdef unix
+		else
+			i = ::connect(s_, (SA*)&sau, sizeof(sau));
+#endif
+		if (i == -1 && deadline_set_ && CONNECT_IN_PROGRESS)
+		{
+			bool rd, wr;
+			int res = waitSocket(s_, false, true, remainingMs(), rd, wr);
+			if (res)
+			{
+				disconnect();
+				return res; // timeout
+			}
+			int err = 0;
+			socklen_t len = sizeof(err);
+			if (!getsockopt(s_, SOL_SOCKET, SO_ERROR, (char*)&err, &len) && !err)
+				i = 0;
+		}
+		if (i == -1)
+		{
+			disconnect();
+			return -1; // connect failed
+		}
+		if (deadline_set_) setNonBlocking(s_, false);
+
+		proto_.reset(session_key_.empty());
+		if (!session_key_.empty())   // resume a session
+		{
+			IoSegment seg = { &session_key_[0], 32 };
+			if (sendSegments(&seg, 1))
+			{
+				disconnect();
+				return -2; // handshake failed (session key send error)
+			}
+			std::shared_ptr<Rmessage> msg = Rmessage::create();
+			return readMessage(*msg);
+		}
+
+		while (proto_.state() == Rprotocol::st_handshake)
+		{
+			int n = receiveSome();
+			if (n)
+			{
+				disconnect();
+				// invalid IDstring or protocol not supported, otherwise no IDstring
+				return (proto_.state() == Rprotocol::st_failed || n == CERR_timeout) ? n : -2;
+			}
+		}
+		auth_ = proto_.auth();
+		salt_[0] = proto_.salt()[0];
+		salt_[1] = proto_.salt()[1];
+		return 0;
+	}
+
+	int parseIDstring(const char *IDstring, int *auth, char *salt)
+	{
+		if (strncmp(IDstring, myID, 4))
+			return -3; // invalid IDstring
+
+		if (strncmp(IDstring + 8, myID + 8, 4) || strncmp(IDstring + 4, myID + 4, 4) > 0)
+			return -4; // protocol not supported
+
+		for (int i = 12; i < 32; i += 4)
+		{
+			if (!strncmp(IDstring + i, "ARuc", 4)) *auth |= A_required | A_crypt;
+			if (!strncmp(IDstring + i, "ARpt", 4)) *auth |= A_required | A_plain;
+			if (IDstring[i] == 'K')
+			{
+				salt[0] = IDstring[i + 1];
+				salt[1] = IDstring[i + 2];
+			}
+		}
+		return 0;
+	}
+
+	bool Rconnection::disconnect()
+	{
+#ifdef WIN32
+		if(s_ != INVALID_SOCKET)
+#else
+		if (s_ > -1)
+#endif
+		{
+			dropConnection(CERR_not_connected);
+			return true;
+		}
+		else return false;
+	}
+
+	void Rconnection::dropConnection(int status)
+	{
+		if (s_ != -1)
+		{
+			closesocket(s_);
+			s_ = -1;
+		}
+		proto_.reset();
+		// detach first - callbacks may reconnect and queue new work
+		std::deque<PipedRequest> p;
+		p.swap(piped_);
+		piped_bytes_ = 0;
+		pipe_holding_ = false;
+		pipe_admitted_ = 0;
+		for (auto& r : p)
+			if (r.done) r.done(status, std::shared_ptr<Rmessage>());
+	}
+	
+	void Rconnection::startDeadline(int timeout_ms)
+	{
+		deadline_set_ = (timeout_ms >= 0);
+		if (deadline_set_)
+			deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	}
+
+	int Rconnection::remainingMs() const
+	{
+		if (!deadline_set_) return -1;
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now >= deadline_) return 0;
+		// round up, poll() must not return before the deadline
+		return (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline_ - now + std::chrono::microseconds(999)).count();
+	}
+
+	int Rconnection::receiveSome()
+	{
+		for (;;)
+		{
+			size_t avail;
+			char *p = proto_.readBuffer(avail);
+			if (!p) return proto_.error();
+			if (deadline_set_)
+			{
+				bool rd, wr;
+				int res = waitSocket(s_, true, false, remainingMs(), rd, wr);
+				if (res) return res;
+			}
+			int n = recv(s_, p, avail, 0);
+			if (n == 0) return CERR_peer_closed;
+			if (n < 0)
+			{
+				if (sockerrno == EINTR) continue;
+				return CERR_io_error;
+			}
+			tstats_.bytes_received += n;
+			return proto_.commitRead(n);
+		}
+	}
+
+	int Rconnection::flushOutput()
+	{
+		if (deadline_set_)
+		{
+			// poll + non-blocking writes so the deadline holds even if the peer stops reading
+			while (proto_.hasOutput())
+			{
+				bool rd, wr;
+				size_t written;
+				int res = waitSocket(s_, false, true, remainingMs(), rd, wr);
+				if (!res) res = sendAvailable(proto_.outputSize(), written);
+				if (res) return res;
+			}
+			return 0;
+		}
+		IoSegment segs[MAX_SEND_SEGMENTS];
+		while (proto_.hasOutput())
+		{
+			int n = proto_.pendingOutput(segs, MAX_SEND_SEGMENTS);
+			size_t total = 0;
+			for (int i = 0; i < n; ++i)
+				total += segs[i].len;
+			if (sendSegments(segs, n))
+				return CERR_send_error;
+			tstats_.bytes_sent += total;
+			proto_.consumeOutput(total);
+		}
+		return 0;
+	}
+
+	int Rconnection::readMessage(Rmessage& msg)
+	{
+		std::chrono::steady_clock::time_point first;
+		bool received = false;
+		while (!proto_.hasMessage())
+		{
+			int res = receiveSome();
+			if (!received)
+			{
+				// the server writes a reply in one go, from here on it is transfer time
+				first = std::chrono::steady_clock::now();
+				received = true;
+			}
+			// answers to OOB messages are queued while reading
+			if (!res && proto_.hasOutput()) res = flushOutput();
+			if (res)
+			{
+				disconnect();
+				return res;
+			}
+		}
+		msg = *proto_.nextMessage();
+		Rsize_t len = msg.length();
+		if (len > tstats_.largest_reply) tstats_.largest_reply = len;
+		// a reply read ahead with an earlier one has no transfer time of its own
+		if (received && len >= TUNE_BULK_MIN)
+		{
+			tstats_.bulk_bytes_received += len;
+			tstats_.bulk_receive_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - first).count();
+		}
+		return 0;
+	}
+
+	int Rconnection::transact(Rmessage& targetMsg)
+	{
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		size_t out = proto_.outputSize();
+		int res = flushOutput();
+		if (res)
+		{
+			disconnect();
+			return res; // send error or timeout
+		}
+		std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+		if (out > tstats_.largest_request) tstats_.largest_request = out;
+		if (out >= TUNE_BULK_MIN)
+		{
+			tstats_.bulk_bytes_sent += out;
+			tstats_.bulk_send_seconds += std::chrono::duration<double>(t1 - t0).count();
+		}
+		res = readMessage(targetMsg);
+		if (res) return res;
+		if (out < TUNE_SMALL_MAX && targetMsg.length() < TUNE_SMALL_MAX)
+		{
+			// fallback RTT estimate where TCP_INFO is not available
+			unsigned int us = (unsigned int)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+			if (!rtt_min_us_ || us < rtt_min_us_) rtt_min_us_ = us;
+		}
+		res = (targetMsg.get_header().cmd & RESP_ERR) == RESP_ERR ? -20 : 0;
+		tuneTransport();
+		return res;
+	}
+
+	void Rconnection::applySocketBuffers(int sndbuf, int rcvbuf)
+	{
+		if (s_ == -1) return;
+		if (sndbuf > 0 && !setsockopt(s_, SOL_SOCKET, SO_SNDBUF, (const char*)&sndbuf, sizeof(sndbuf)))
+			sndbuf_asked_ = sndbuf;
+		if (rcvbuf > 0 && !setsockopt(s_, SOL_SOCKET, SO_RCVBUF, (const char*)&rcvbuf, sizeof(rcvbuf)))
+			rcvbuf_asked_ = rcvbuf;
+		socklen_t len = sizeof(int);
+		getsockopt(s_, SOL_SOCKET, SO_SNDBUF, (char*)&tstats_.sndbuf, &len);
+		len = sizeof(int);
+		getsockopt(s_, SOL_SOCKET, SO_RCVBUF, (char*)&tstats_.rcvbuf, &len);
+	}
+
+	void Rconnection::updateRtt()
+	{
+#if defined(__linux__) && defined(TCP_INFO)
+		if (family_ == AF_INET && s_ != -1)
+		{
+			struct tcp_info ti;
+			socklen_t len = sizeof(ti);
+			if (!getsockopt(s_, IPPROTO_TCP, TCP_INFO, &ti, &len) && ti.tcpi_rtt)
+			{
+				tstats_.rtt_us = ti.tcpi_rtt;
+				return;
+			}
+		}
+#endif
+		tstats_.rtt_us = rtt_min_us_;
+	}
+
+	void Rconnection::setTransportOptions(const RtransportOptions& opt)
+	{
+		topt_ = opt;
+		applySocketBuffers(topt_.sndbuf, topt_.rcvbuf);
+		server_buffer_asked_ = 0;
+	}
+
+	int Rconnection::setServerBufferSize(int size)
+	{
+		std::shared_ptr<Rmessage> msg = Rmessage::create();
+		std::shared_ptr<Rmessage> cmdMessage = Rmessage::create(CMD_setBufferSize, size);
+		int res = request(*msg, *cmdMessage);
+		if (!res) res = CMD_STAT(msg->command());
+		if (!res) tstats_.server_buffer = size;
+		return res;
+	}
+
+	void Rconnection::queueServerBufferSize(int size)
+	{
+		/* pipelined, so it goes out with the next request and its reply is read
+		   by that request's drainPipeline() - the call that triggered the tuning
+		   has already succeeded and must not fail or disconnect because of it */
+		std::shared_ptr<Rmessage> msg = Rmessage::create(CMD_setBufferSize, size);
+		size_t before = proto_.outputSize();
+		if (proto_.encode(*msg, msg)) return;
+		server_buffer_asked_ = size;
+		PipedRequest r = { [this, size](int status, const std::shared_ptr<Rmessage>& reply)
+		{
+			if (!status) status = CMD_STAT(reply->command());
+			if (!status) tstats_.server_buffer = size;
+		}, proto_.outputSize() - before };
+		piped_.push_back(r);
+		piped_bytes_ += r.bytes;
+	}
+
+	void Rconnection::tuneTransport()
+	{
+		if (pumping_ || s_ == -1) return;
+		if (!topt_.adaptive && (!topt_.server_buffer || server_buffer_asked_ == topt_.server_buffer)) return;
+
+		if (topt_.server_buffer && server_buffer_asked_ != topt_.server_buffer)
+			queueServerBufferSize(topt_.server_buffer);
+
+		if (topt_.adaptive)
+		{
+			updateRtt();
+			/* a window-limited transfer measures window / RTT, so twice the
+			   measured bandwidth-delay product keeps doubling the buffers until
+			   the link, not the window, is the limit. there is no point in
+			   buffers larger than the largest message though */
+			double bps = std::max(tstats_.send_throughput(), tstats_.receive_throughput());
+			double want = 2.0 * bps * tstats_.rtt_us / 1e6;
+			want = std::min(want, (double)std::max(tstats_.largest_request, tstats_.largest_reply));
+			int size = (int)std::min(want, (double)topt_.max_buffer);
+			// compared with what was asked for, the kernel may report more
+			applySocketBuffers((!topt_.sndbuf && size > (sndbuf_asked_ ? sndbuf_asked_ : tstats_.sndbuf)) ? size : 0,
+				(!topt_.rcvbuf && size > (rcvbuf_asked_ ? rcvbuf_asked_ : tstats_.rcvbuf)) ? size : 0);
+
+			if (!topt_.server_buffer && tstats_.largest_reply > (Rsize_t)std::max(tstats_.server_buffer, RSERVE_DEFAULT_BUFFER))
+			{
+				Rsize_t sb = RSERVE_DEFAULT_BUFFER;
+				while (sb < tstats_.largest_reply && sb < (Rsize_t)topt_.max_buffer) sb *= 2;
+				if (sb > (Rsize_t)topt_.max_buffer) sb = topt_.max_buffer;
+				if ((int)sb > std::max(tstats_.server_buffer, server_buffer_asked_)) queueServerBufferSize((int)sb);
+			}
+		}
+	}
+
+	int Rconnection::sendAvailable(size_t max, size_t& written)
+	{
+		written = 0;
+		IoSegment segs[MAX_SEND_SEGMENTS];
+		int n = proto_.pendingOutput(segs, MAX_SEND_SEGMENTS);
+		int k = 0;
+		for (size_t total = 0; k < n && total < max; ++k)
 		{
-#ifdef CAN_TCP_NODELAY
-			int opt = 1;
-			setsockopt(s_, IPPROTO_TCP, TCP_NODELAY, (const char*) &opt, sizeof(opt));
-#endif
-			i = ::connect(s_, (SA*)&sai, sizeof(sai));
+			if (segs[k].len > max - total)
+				segs[k].len = max - total;
+			total += segs[k].len;
 		}
-#ifdef unix
-		else
-			i = ::connect(s_, (SA*)&sau, sizeof(sau));
+#ifdef WIN32
+		WSABUF wb[MAX_SEND_SEGMENTS];
+		for (int i = 0; i < k; ++i)
+		{
+			wb[i].buf = (CHAR*)segs[i].data;
+			wb[i].len = (ULONG)segs[i].len;
+		}
+		DWORD sent = 0;
+		if (WSASend(s_, wb, k, &sent, 0, NULL, NULL) == SOCKET_ERROR)
+			return CERR_send_error;
+#else
+		struct iovec iov[MAX_SEND_SEGMENTS];
+		for (int i = 0; i < k; ++i)
+		{
+			iov[i].iov_base = (void*)segs[i].data;
+			iov[i].iov_len = segs[i].len;
+		}
+		struct msghdr mh;
+		memset(&mh, 0, sizeof(mh));
+		mh.msg_iov = iov;
+		mh.msg_iovlen = k;
+		int flags = MSG_DONTWAIT;
+#ifdef MSG_NOSIGNAL
+		flags |= MSG_NOSIGNAL;
 #endif
-		if (i == -1)
+		ssize_t sent = sendmsg(s_, &mh, flags);
+		if (sent < 0)
 		{
-			disconnect();
-			return -1; // connect failed
+			if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+			return CERR_send_error;
 		}
+#endif
+		written = (size_t)sent;
+		tstats_.bytes_sent += written;
+		proto_.consumeOutput(written);
+		return 0;
+	}
 
-		if (!session_key_.empty())   // resume a session
+	int Rconnection::pumpPipeline(size_t until, bool wait)
+	{
+		// writes and reads at the same time, so neither side can block on a full socket buffer
+		int res = 0;
+		pumping_ = true;
+		const size_t done0 = pipe_done_;
+		for (bool first = true; wait ? piped_.size() > until : first; first = false)
 		{
-			int n = ::send(s_, &session_key_[0], 32, 0);
-			if (n != 32)
+			// callbacks may queue requests behind a held one, let pipeSubmit() re-check its hold
+			if (pipe_holding_ && pipe_done_ != done0) break;
+			size_t out = pipe_holding_ ? pipe_admitted_ : proto_.outputSize();
+			bool rd = false, wr = false;
+			res = waitSocket(s_, true, out > 0, wait ? remainingMs() : 0, rd, wr);
+			if (res == CERR_timeout && !wait)
 			{
-				disconnect();
-				return -2; // handshake failed (session key send error)
+				res = 0;
+				continue;
+			}
+			if (res) break;
+			if (wr)
+			{
+				size_t written;
+				if ((res = sendAvailable(out, written)) != 0) break;
+				if (pipe_holding_) pipe_admitted_ -= written;
+			}
+			if (!rd) continue;
+			size_t queued = proto_.outputSize();
+			if ((res = receiveSome()) != 0) break;
+			// OOB answers are put in front of the held request, they may go out
+			if (pipe_holding_) pipe_admitted_ += proto_.outputSize() - queued;
+			while (!piped_.empty() && proto_.hasMessage())
+			{
+				std::shared_ptr<Rmessage> msg = proto_.nextMessage();
+				PipedRequest r = piped_.front();
+				piped_.pop_front();
+				piped_bytes_ -= r.bytes;
+				++pipe_done_;
+				int status = (msg->get_header().cmd & RESP_ERR) == RESP_ERR ? -20 : 0;
+				if (r.done) r.done(status, msg);
+				if (s_ == -1) break; // disconnected by the callback
+			}
+			if (s_ == -1) break;
+			if (proto_.hasMessage())
+			{
+				res = CERR_malformed_packet; // a reply nobody asked for - the stream is out of sync
+				break;
 			}
-			std::shared_ptr<Rmessage> msg = Rmessage::create();
-			int q = msg->read(*this);
-			return q;
 		}
+		pumping_ = false;
+		if (res) dropConnection(res);
+		return res;
+	}
 
-		int n = recv(s_, IDstring, sizeof(IDstring), 0);
-		if (n != 32)
+	int Rconnection::pipeSubmit(size_t bytes, const MessageCallback& done)
+	{
+		PipedRequest r = { done, bytes };
+		piped_.push_back(r);
+		piped_bytes_ += bytes;
+		if (pumping_) return 0; // queued from a callback, written by the running pump
+
+		// hold the new request back until the replies of older ones make room for it
+		startDeadline(timeout_ms_);
+		size_t ahead = piped_.size() - 1;
+		size_t done0 = pipe_done_;
+		pipe_holding_ = true;
+		pipe_admitted_ = proto_.outputSize() - bytes;
+		while (pipe_done_ - done0 < ahead && piped_bytes_ > pipe_limit_)
 		{
-			disconnect();
-			return -2; // handshake failed (no IDstring)
+			// errors are reported through the callbacks, including the one of this request
+			if (pumpPipeline(piped_.size() - 1, true)) return 0;
 		}
+		pipe_holding_ = false;
 
-		if (strncmp(IDstring, myID, 4))
-		{
-			disconnect();
-			return -3; // invalid IDstring
-		}
+		// start writing, but do not wait for anything
+		pumpPipeline(0, false);
+		return 0;
+	}
 
-		if (strncmp(IDstring + 8, myID + 8, 4) || strncmp(IDstring + 4, myID + 4, 4) > 0)
-		{
-			disconnect();
-			return -4; // protocol not supported
-		}
+	int Rconnection::drainPipeline()
+	{
+		if (piped_.empty()) return 0;
+		if (pumping_) return CERR_not_supported; // blocking call from a pipeline callback
+		int res = pumpPipeline(0, true);
+		if (!res && s_ == -1) res = CERR_not_connected; // a callback disconnected
+		return res;
+	}
+
+	int Rconnection::pipeSync()
+	{
+		if (s_ == -1) return piped_.empty() ? 0 : CERR_not_connected;
+		startDeadline(timeout_ms_);
+		return drainPipeline();
+	}
+
+	int Rconnection::pipeRequest(const std::shared_ptr<Rmessage>& msg, const MessageCallback& done)
+	{
+		if (s_ == -1) return -5; // not connected
+		size_t before = proto_.outputSize();
+		int res = proto_.encode(*msg, msg);
+		if (res) return res;
+		return pipeSubmit(proto_.outputSize() - before, done);
+	}
+
+	int Rconnection::pipeEval(const char *cmd, const EvalCallback& done)
 	{
-		int i = 12;
-		while (i < 32)
+		return pipeRequest(Rmessage::create(CMD_eval, cmd),
+			[done](int status, const std::shared_ptr<Rmessage>& msg)
 		{
-			if (!strncmp(IDstring + i, "ARuc", 4)) auth_ |= A_required | A_crypt;
-			if (!strncmp(IDstring + i, "ARpt", 4)) auth_ |= A_required | A_plain;
-			if (IDstring[i] == 'K')
-			{
-				salt_[0] = IDstring[i + 1];
-				salt_[1] = IDstring[i + 2];
-			}
-			i += 4;
-		}
+			std::shared_ptr<Rexp> exp;
+			if (!status) exp = decodeSEXPResponse(msg, &status);
+			if (done) done(status, exp);
+		});
 	}
-	return 0;
+
+	int Rconnection::pipeVoidEval(const char *cmd, const StatusCallback& done)
+	{
+		return pipeRequest(Rmessage::create(CMD_voidEval, cmd),
+			[done](int status, const std::shared_ptr<Rmessage>&)
+		{
+			if (done) done(status);
+		});
 	}
 
-	bool Rconnection::disconnect()
+	int Rconnection::pipeAssign(const char *symbol, const std::shared_ptr<Rexp>& exp, const StatusCallback& done)
 	{
-#ifdef WIN32
-		if(s_ != INVALID_SOCKET)
-#else
-		if (s_ > -1)
-#endif
+		if (s_ == -1) return -5; // not connected
+		size_t before = proto_.outputSize();
+		int res = proto_.encodeAssign(symbol, *exp, exp);
+		if (res) return res;
+		return pipeSubmit(proto_.outputSize() - before,
+			[done](int status, const std::shared_ptr<Rmessage>& msg)
 		{
-			closesocket(s_);
-			s_ = -1;
-			return true;
-		}
-		else return false;
+			if (!status) status = CMD_STAT(msg->command());
+			if (done) done(status);
+		});
 	}
-	
+
 	int Rconnection::getLastSocketError(char* buffer, size_t buffer_len, int options) const
 	{
 		return sockerrorchecks(buffer, buffer_len, options);
@@ -889,36 +2441,39 @@ namespace Rconnection2 {
 
 	int Rconnection::request(Rmessage& msg, int cmd, Rsize_t len, void *par)
 	{
-		struct phdr ph;
-
 		if (s_ == -1) return -5; // not connected
-		memset(&ph, 0, sizeof(ph));
-		ph.len = itop(len);
-		ph.cmd = itop(cmd);
-		if (send(s_, (char*)&ph, sizeof(ph), 0) != sizeof(ph))
-		{
-			disconnect();
-			return -9;
-		}
-		if (len > 0 && send(s_, (char*)par, len, 0) != len)
+		startDeadline(timeout_ms_);
+		int res = drainPipeline();
+		if (res) return res;
+		IoSegment seg = { par, len };
+		proto_.encode(cmd, &seg, (len > 0) ? 1 : 0);
+		res = flushOutput();
+		if (res)
 		{
 			disconnect();
-			return -9;
+			return res;
 		}
-		return msg.read(*this);
+		return readMessage(msg);
 	}
 
 	int Rconnection::request(Rmessage& targetMsg, Rmessage& contents)
 	{
 		if (s_ == -1) return -5; // not connected
-		if (contents.send(*this))
-		{
-			disconnect();
-			return -9; // send error
-		}
-		int res = targetMsg.read(*this);
+		startDeadline(timeout_ms_);
+		int res = drainPipeline();
+		if (res) return res;
+		proto_.encode(contents);
+		return transact(targetMsg);
+	}
+
+	int Rconnection::request(Rmessage& targetMsg, int cmd, const IoSegment *segs, int count)
+	{
+		if (s_ == -1) return -5; // not connected
+		startDeadline(timeout_ms_);
+		int res = drainPipeline();
 		if (res) return res;
-		return (targetMsg.get_header().cmd & RESP_ERR) == RESP_ERR ? -20 : 0;
+		proto_.encode(cmd, segs, count);
+		return transact(targetMsg);
 	}
 
 	/** --- high-level functions -- */
@@ -933,30 +2488,94 @@ namespace Rconnection2 {
 
 	int Rconnection::assign(const char *symbol, const Rexp& exp)
 	{
+		if (s_ == -1) return -5; // not connected
+		startDeadline(timeout_ms_);
+		int res = drainPipeline();
+		if (res) return res;
 		std::shared_ptr<Rmessage> msg = Rmessage::create();
-		std::shared_ptr<Rmessage> cmdMessage = Rmessage::create(CMD_setSEXP);
-
-		int tl = strlen(symbol) + 1;
-		if (tl & 3) tl = (tl + 4) & 0xfffc;
-		Rsize_t xl = exp.storageSize();
-		Rsize_t hl = 4 + tl + 4;
-		if (xl > 0x7fffff) hl += 4;
-		cmdMessage->alloc_data(hl + xl);
-		((unsigned int*)cmdMessage->get_data())[0] = SET_PAR(DT_STRING, tl);
-		((unsigned int*)cmdMessage->get_data())[0] = itop(((unsigned int*)cmdMessage->get_data())[0]);
-		strcpy(cmdMessage->get_data() + 4, symbol);
-		((unsigned int*)(cmdMessage->get_data() + 4 + tl))[0] = SET_PAR((Rsize_t)((xl > 0x7fffff) ? (DT_SEXP | DT_LARGE) : DT_SEXP), (Rsize_t)xl);
-		((unsigned int*)(cmdMessage->get_data() + 4 + tl))[0] = itop(((unsigned int*)(cmdMessage->get_data() + 4 + tl))[0]);
-		if (xl > 0x7fffff)
-			((unsigned int*)(cmdMessage->get_data() + 4 + tl))[1] = itop(xl >> 24);
-		exp.store(cmdMessage->get_data() + hl);
-
-		int res = request(*msg, *cmdMessage);
+		proto_.encodeAssign(symbol, exp);
+		res = transact(*msg);
 		if (!res)
 			res = CMD_STAT(msg->command());
 		return res;
 	}
 
+	// appends str as an R string literal
+	static void appendRString(std::string& out, const std::string& str)
+	{
+		out += '"';
+		for (char c : str)
+		{
+			switch (c)
+			{
+				case '\\': out += "\\\\"; break;
+				case '"': out += "\\\""; break;
+				case '\n': out += "\\n"; break;
+				case '\r': out += "\\r"; break;
+				case '\t': out += "\\t"; break;
+				default: out += c;
+			}
+		}
+		out += '"';
+	}
+
+	std::vector<RbatchResult> Rconnection::evalBatch(const std::vector<std::string>& exprs, int *status)
+	{
+		std::vector<RbatchResult> results;
+		if (status) *status = 0;
+		if (exprs.empty()) return results;
+
+		/* each expression is parsed and evaluated on its own, so a syntax or
+		   run-time error only fails that one; R answers with a list of
+		   list(0L, value) or list(1L, message) */
+		std::string cmd = "local({.e <- c(";
+		for (size_t i = 0; i < exprs.size(); ++i)
+		{
+			if (i) cmd += ',';
+			appendRString(cmd, exprs[i]);
+		}
+		cmd += "); lapply(.e, function(.x) tryCatch(list(0L, eval(parse(text = .x), envir = .GlobalEnv)),"
+			" error = function(.c) list(1L, conditionMessage(.c))))})";
+
+		int res = 0;
+		std::shared_ptr<Rexp> exp = eval_to_Rexp(cmd.c_str(), &res, 0);
+		if (!res && (!exp || exp->get_type() != XT_VECTOR || ((Rvector*)exp.get())->length() != exprs.size()))
+			res = CERR_malformed_packet;
+		if (res)
+		{
+			if (status) *status = res;
+			return results;
+		}
+
+		Rvector *list = (Rvector*)exp.get();
+		results.resize(exprs.size());
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			std::shared_ptr<Rexp> item = list->elementAt((int)i);
+			if (!item || item->get_type() != XT_VECTOR || ((Rvector*)item.get())->length() != 2)
+			{
+				if (status) *status = CERR_malformed_packet;
+				return std::vector<RbatchResult>();
+			}
+			Rvector *pair = (Rvector*)item.get();
+			std::shared_ptr<Rexp> code = pair->elementAt(0);
+			std::shared_ptr<Rexp> value = pair->elementAt(1);
+			if (code && code->get_type() == XT_ARRAY_INT && ((Rinteger*)code.get())->intAt(0) == 0)
+			{
+				results[i].status = 0;
+				results[i].value = value;
+				continue;
+			}
+			results[i].status = CERR_eval_failed;
+			if (value && value->get_type() == XT_ARRAY_STR)
+			{
+				const std::vector<const char*>& msgs = ((Rstrings*)value.get())->strings();
+				if (!msgs.empty() && msgs[0]) results[i].error = msgs[0];
+			}
+		}
+		return results;
+	}
+
 	int Rconnection::voidEval(const char *cmd)
 	{
 		int status = 0;
@@ -966,20 +2585,89 @@ namespace Rconnection2 {
 
 	std::shared_ptr<Rexp> Rconnection::eval_to_Rexp(const char *cmd, int *status, int opt)
 	{
-		/* opt = 1 -> void eval */
+		/* opt = 1 -> void eval, opt = 2 -> lazy decoding */
 		std::shared_ptr<Rmessage> msg = Rmessage::create();
 		std::shared_ptr<Rmessage> cmdMessage = Rmessage::create((opt & 1) ? CMD_voidEval : CMD_eval, cmd);
 		int res = request(*msg, *cmdMessage);
 		if (status) *status = res;
 		if (res || (opt & 1))
 			return std::shared_ptr<Rexp>();
-		else if (msg->get_par_count() != 1 || (ptoi(msg->get_par(0, 0)) & 0x3f) != DT_SEXP)
+		else
+			return decodeSEXPResponse(msg, status, (opt & 2) != 0);
+	}
+
+	std::shared_ptr<Rmessage> Rconnection::evalMessage(const char *cmd, int *status)
+	{
+		std::shared_ptr<Rmessage> msg = Rmessage::create();
+		std::shared_ptr<Rmessage> cmdMessage = Rmessage::create(CMD_eval, cmd);
+		int res = request(*msg, *cmdMessage);
+		if (status) *status = res;
+		return res ? std::shared_ptr<Rmessage>() : msg;
+	}
+
+	int Rconnection::evalIntoArray(const char *cmd, int xt, char *buf, size_t n, size_t elt)
+	{
+		if (s_ == -1) return -5; // not connected
+		size_t len = n * elt;
+		if (len > 0xffffffffu - 16) return CERR_not_supported;
+		startDeadline(timeout_ms_);
+		int res = drainPipeline();
+		if (res) return res;
+		std::shared_ptr<Rmessage> msg = Rmessage::create();
+		std::shared_ptr<Rmessage> cmdMessage = Rmessage::create(CMD_eval, cmd);
+		// the DT_SEXP and XT headers (4 or 8 bytes each) stay in the message
+		proto_.receiveInto(buf, (Rsize_t)len, 16);
+		res = request(*msg, *cmdMessage);
+		if (res) return res;
+
+		Rsize_t hl;
+		const unsigned int *h = msg->get_head(hl);
+		if (hl && msg->get_data() == buf)
+		{
+			unsigned int dt = ptoi(h[0]);
+			size_t i = (dt & DT_LARGE) ? 2 : 1;
+			if ((dt & 0x3f) != DT_SEXP || i * 4 >= hl) return CERR_shape_mismatch;
+			unsigned int x = ptoi(h[i]);
+			uint64_t xlen = x >> 8;
+			if (x & XT_LARGE)
+			{
+				if ((i + 2) * 4 > hl) return CERR_shape_mismatch;
+				xlen |= (uint64_t)ptoi(h[i + 1]) << 24;
+				i += 2;
+			}
+			else
+				++i;
+			if ((int)(x & 0x3f) != xt || (x & XT_HAS_ATTR) || i * 4 != hl || xlen != len)
+				return CERR_shape_mismatch;
+#ifdef SWAPEND
+			if (xt == XT_ARRAY_DOUBLE)
+				swapBytes64(buf, n);
+			else
+				swapBytes32(buf, n);
+#endif
+			return 0;
+		}
+
+		// the payload had another size, e.g. attributes (names, dim ...) are present
+		int status;
+		std::shared_ptr<Rexp> exp = decodeSEXPResponse(msg, &status);
+		if (status) return CERR_shape_mismatch;
+		if (exp->get_type() != xt || exp->length() != n) return CERR_shape_mismatch;
+		if (len)
+			memcpy(buf, (xt == XT_ARRAY_DOUBLE) ? (const char*)static_cast<Rdouble*>(exp.get())->doubleArray()
+				: (const char*)static_cast<Rinteger*>(exp.get())->intArray(), len);
+		return 0;
+	}
+
+	std::shared_ptr<Rexp> decodeSEXPResponse(const std::shared_ptr<Rmessage>& msg, int *status, bool lazy)
+	{
+		if (msg->get_par_count() != 1 || (ptoi(msg->get_par(0, 0)) & 0x3f) != DT_SEXP)
 		{
 			if (status) *status = -12; // returned object is not SEXP
 			return std::shared_ptr<Rexp>();
 		}
-		else
-			return Rexp::create(msg);
+		if (status) *status = 0;
+		return Rexp::create(msg, lazy);
 	}
 
 	/** detached eval (aka detached void eval) initiates eval and detaches the session.
@@ -1042,21 +2730,25 @@ namespace Rconnection2 {
 
 	Rsize_t Rconnection::readFile(char *buf, unsigned int len)
 	{
+		if (s_ == -1) return CERR_io_error;
+		// older pipelined replies must not land in buf
+		startDeadline(timeout_ms_);
+		int res = drainPipeline();
+		if (res) return (res == CERR_timeout) ? CERR_timeout : CERR_io_error;
 		std::shared_ptr<Rmessage> msg = Rmessage::create();
 		std::shared_ptr<Rmessage> cmdMessage = Rmessage::create(CMD_readFile, len);
-		int res = request(*msg, *cmdMessage);
+		proto_.receiveInto(buf, len);
+		res = request(*msg, *cmdMessage);
 		if (!res)
 		{
 			// FIXME: Rserve up to 0.4-0 actually sends buggy response - it ommits DT_BYTESTREAM header!
 			if (msg->get_len() > len)
 				// we're in trouble here - techincally we should not get this
 				return CERR_malformed_packet;
-
-			if (msg->get_len() > 0)
-				memcpy(buf, msg->get_data(), msg->get_len());
+			// the payload was received into buf directly
 			return msg->get_len();
 		}
-		return CERR_io_error;
+		return (res == CERR_timeout) ? CERR_timeout : CERR_io_error;
 	}
 
 	int Rconnection::writeFile(const char *buf, unsigned int len)
@@ -1088,12 +2780,194 @@ namespace Rconnection2 {
 		return res;
 	}
 
-	int Rconnection::login(const char *user, const char *pwd)
+	int64_t Rconnection::streamDownload(const char *fn, const ChunkSink& put, unsigned int chunk, int depth)
+	{
+		if (s_ == -1) return -5; // not connected
+		// the chunk replies claim the receive buffers in order, nothing else may be in flight
+		startDeadline(timeout_ms_);
+		int res = drainPipeline();
+		if (!res) res = openFile(fn);
+		if (res) return res;
+
+		if (chunk == 0) chunk = 1;
+		if (depth < 1) depth = 1;
+		std::vector< std::vector<char> > bufs(depth, std::vector<char>(chunk));
+		int64_t total = 0;
+		int err = 0;
+		bool eof = false;
+
+		std::function<void(int)> issue = [&](int i)
+		{
+			proto_.receiveInto(&bufs[i][0], chunk);
+			pipeRequest(Rmessage::create(CMD_readFile, (int)chunk),
+				[&, i](int status, const std::shared_ptr<Rmessage>& msg)
+			{
+				if (err) return;
+				Rsize_t n = status ? 0 : msg->get_len();
+				if (status)
+					err = status;
+				else if (n > chunk)
+					err = CERR_malformed_packet;
+				else if (n == 0)
+					eof = true; // the requests still in flight get empty replies as well
+				else if (!put(&bufs[i][0], n))
+					err = CERR_io_error;
+				else
+				{
+					total += n;
+					if (!eof) issue(i);
+				}
+			});
+		};
+		for (int i = 0; i < depth && !err && !eof; ++i)
+			issue(i);
+		res = pipeSync();
+		if (!res) res = err;
+		if (s_ != -1)
+		{
+			int cres = closeFile();
+			if (!res) res = cres;
+		}
+		return res ? res : total;
+	}
+
+	int64_t Rconnection::streamUpload(const char *fn, const ChunkSource& get, unsigned int chunk, int depth)
+	{
+		if (s_ == -1) return -5; // not connected
+		int res = createFile(fn);
+		if (res) return res;
+
+		// DT_BYTESTREAM without DT_LARGE
+		if (chunk == 0) chunk = 1;
+		if (chunk > 0x7fffff) chunk = 0x7fffff;
+		if (depth < 1) depth = 1;
+		std::vector< std::vector<char> > bufs(depth, std::vector<char>(chunk));
+		int64_t total = 0;
+		int err = 0;
+		bool eof = false;
+
+		std::function<void(int)> issue = [&](int i)
+		{
+			int64_t n = get(&bufs[i][0], chunk);
+			if (n < 0)
+			{
+				err = CERR_io_error;
+				return;
+			}
+			if (n == 0)
+			{
+				eof = true;
+				return;
+			}
+			// the chunk is sent in place - the buffer is reused only after its reply
+			unsigned int par = itop(SET_PAR(DT_BYTESTREAM, (unsigned int)n));
+			IoSegment segs[2] = { { &par, sizeof(par) }, { &bufs[i][0], (size_t)n } };
+			int eres = proto_.encode(CMD_writeFile, segs, 2);
+			if (eres)
+			{
+				err = eres;
+				return;
+			}
+			// depth already bounds the bytes in flight, the pipeline cap would
+			// serialise the default 4 x 1MB chunks - so the chunks do not count
+			pipeSubmit(0,
+				[&, n, i](int status, const std::shared_ptr<Rmessage>&)
+			{
+				if (err) return;
+				if (status)
+					err = status;
+				else
+				{
+					total += n;
+					if (!eof) issue(i);
+				}
+			});
+		};
+		for (int i = 0; i < depth && !err && !eof; ++i)
+			issue(i);
+		res = pipeSync();
+		if (!res) res = err;
+		if (s_ != -1)
+		{
+			int cres = closeFile();
+			if (!res) res = cres;
+		}
+		return res ? res : total;
+	}
+
+	static int64_t readFd(int fd, char *buf, size_t len)
+	{
+		size_t got = 0;
+		while (got < len)
+		{
+#ifdef unix
+			ssize_t n = ::read(fd, buf + got, len - got);
+			if (n < 0 && errno == EINTR) continue;
+#else
+			int n = _read(fd, buf + got, (unsigned int)(len - got));
+#endif
+			if (n < 0) return -1;
+			if (n == 0) break;
+			got += n;
+		}
+		return (int64_t)got;
+	}
+
+	static bool writeFd(int fd, const char *buf, size_t len)
+	{
+		while (len > 0)
+		{
+#ifdef unix
+			ssize_t n = ::write(fd, buf, len);
+			if (n < 0 && errno == EINTR) continue;
+#else
+			int n = _write(fd, buf, (unsigned int)len);
+#endif
+			if (n <= 0) return false;
+			buf += n;
+			len -= n;
+		}
+		return true;
+	}
+
+	int64_t Rconnection::downloadFile(const char *fn, std::ostream& out, unsigned int chunk, int depth)
+	{
+		return streamDownload(fn, [&out](const char *buf, size_t len)
+		{
+			return (bool)out.write(buf, len);
+		}, chunk, depth);
+	}
+
+	int64_t Rconnection::downloadFile(const char *fn, int fd, unsigned int chunk, int depth)
+	{
+		return streamDownload(fn, [fd](const char *buf, size_t len)
+		{
+			return writeFd(fd, buf, len);
+		}, chunk, depth);
+	}
+
+	int64_t Rconnection::uploadFile(const char *fn, std::istream& in, unsigned int chunk, int depth)
+	{
+		return streamUpload(fn, [&in](char *buf, size_t len) -> int64_t
+		{
+			in.read(buf, len);
+			return in.bad() ? -1 : (int64_t)in.gcount();
+		}, chunk, depth);
+	}
+
+	int64_t Rconnection::uploadFile(const char *fn, int fd, unsigned int chunk, int depth)
+	{
+		return streamUpload(fn, [fd](char *buf, size_t len)
+		{
+			return readFd(fd, buf, len);
+		}, chunk, depth);
+	}
+
+	int buildLoginString(int auth, const char *salt, const char *user, const char *pwd, std::vector<char>& out)
 	{
 		char *authbuf, *c;
-		if (!(auth_&A_required)) return 0;
-		std::vector<char> _buff(strlen(user) + strlen(pwd) + 22);
-		authbuf = &_buff[0];
+		out.assign(strlen(user) + strlen(pwd) + 22, 0);
+		authbuf = &out[0];
 		strcpy(authbuf, user);
 		c = authbuf + strlen(user);
 		*c = '\n';
@@ -1101,18 +2975,31 @@ namespace Rconnection2 {
 		strcpy(c, pwd);
 
 #ifdef unix
-		if (auth_&A_crypt)
-			strcpy(c, crypt(pwd, salt_));
+		if (auth&A_crypt)
+		{
+			char saltz[3] = { salt[0], salt[1], 0 };
+			strcpy(c, crypt(pwd, saltz));
+		}
 #else
-		if (!(auth_&A_plain))
+		(void)salt;
+		if (!(auth&A_plain))
 		{
 			return CERR_auth_unsupported;
 		}
 #endif
+		return 0;
+	}
+
+	int Rconnection::login(const char *user, const char *pwd)
+	{
+		if (!(auth_&A_required)) return 0;
+		std::vector<char> authbuf;
+		int res = buildLoginString(auth_, salt_, user, pwd, authbuf);
+		if (res) return res;
 
 		std::shared_ptr<Rmessage> msg = Rmessage::create();
-		std::shared_ptr<Rmessage> cmdMessage = Rmessage::create(CMD_login, authbuf);
-		int res = request(*msg, *cmdMessage);
+		std::shared_ptr<Rmessage> cmdMessage = Rmessage::create(CMD_login, &authbuf[0]);
+		res = request(*msg, *cmdMessage);
 		if (!res) res = CMD_STAT(msg->command());
 		return res;
 	}
@@ -44,11 +44,18 @@ typedef int SOCKET;
 #endif
 #include <iostream>
 #include <vector>
+#include <deque>
+#include <functional>
+#include <chrono>
 #include <memory>
 #include <algorithm>
 #include <string>
 #include <cstring>
 #include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <complex>
 #include "Rsrv.h"
 
 #ifdef WIN32
@@ -87,6 +94,10 @@ namespace Rconnection2 {
 #define CERR_out_of_mem       -10
 #define CERR_not_supported    -11
 #define CERR_io_error         -12
+#define CERR_timeout          -13
+#define CERR_eval_failed      -14
+#define CERR_shape_mismatch   -15
+#define CERR_pool_exhausted   -17 // no free pooled connection within the timeout
 
 	// this one is custom - authentication method required by
 	// the server is not supported in this client
@@ -97,6 +108,13 @@ namespace Rconnection2 {
 #define A_crypt    0x002
 #define A_plain    0x004
 
+	// one contiguous piece of an outgoing message, see IRconnection::sendSegments()
+	struct IoSegment
+	{
+		const void *data;
+		size_t len;
+	};
+
 	class RCONNECTION2_API IRconnection
 	{
 	protected:
@@ -106,6 +124,97 @@ namespace Rconnection2 {
 		virtual int connect() = 0;
 		virtual bool disconnect() = 0;
 		virtual SOCKET getSocket() const = 0;
+
+		/** sends all segments back to back using gather I/O (one syscall in
+			the common case), resuming after partial writes.
+			returns 0 on success or CERR_send_error */
+		virtual int sendSegments(const IoSegment *segs, int count);
+
+		/** receives exactly len bytes into buf, retrying on short reads.
+			returns 0 on success, CERR_peer_closed or CERR_io_error */
+		virtual int receive(void *buf, Rsize_t len);
+	};
+
+	//===================================== RexpArena ---- storage of decoded nodes
+
+	/* bump allocator for the Rexp nodes decoded from one received message and
+	   their shared_ptr control blocks. nothing is released individually, the
+	   chunks are freed together with the MessageBuffer the arena belongs to,
+	   which every control block keeps alive. allocate() may be called from
+	   several threads (lazy decoding) */
+	class RCONNECTION2_API RexpArena
+	{
+	private:
+		explicit RexpArena(const RexpArena&);
+		RexpArena& operator=(const RexpArena&);
+
+	public:
+		RexpArena()
+		:
+			enabled_(false),
+			mtx_(),
+			chunks_(),
+			cur_(NULL),
+			end_(NULL),
+			next_chunk_(0),
+			allocs_(0)
+		{
+		}
+
+		~RexpArena();
+
+		/** chunks start small and grow with the number of nodes allocated,
+			so a message holding a single large vector costs one small chunk */
+		void enable();
+		bool enabled() const { return enabled_; }
+
+		void *allocate(size_t n);
+
+		/** number of allocate() calls and chunks obtained from the heap */
+		size_t allocations() const { return allocs_; }
+		size_t chunks() const { return chunks_.size(); }
+
+	private:
+		bool enabled_;
+		std::mutex mtx_;
+		std::vector<char*> chunks_;
+		char *cur_, *end_;
+		size_t next_chunk_;
+		size_t allocs_;
+	};
+
+	/** allocator for the control blocks of arena nodes, see Rexp::adopt() */
+	template<class T> struct RexpArenaAllocator
+	{
+		typedef T value_type;
+
+		std::shared_ptr<RexpArena> arena;
+
+		explicit RexpArenaAllocator(const std::shared_ptr<RexpArena>& a) : arena(a) {}
+		template<class U> RexpArenaAllocator(const RexpArenaAllocator<U>& other) : arena(other.arena) {}
+
+		T *allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T))); }
+		void deallocate(T*, size_t) {}
+	};
+
+	template<class T, class U>
+	inline bool operator==(const RexpArenaAllocator<T>& a, const RexpArenaAllocator<U>& b) { return a.arena == b.arena; }
+	template<class T, class U>
+	inline bool operator!=(const RexpArenaAllocator<T>& a, const RexpArenaAllocator<U>& b) { return a.arena != b.arena; }
+
+	/** destroys a node adopted by Rexp::adopt(); gives its memory back to the
+		heap unless it is in an arena */
+	struct RexpArenaDeleter
+	{
+		RexpArena *arena;
+
+		explicit RexpArenaDeleter(RexpArena *a) : arena(a) {}
+		template<class T> void operator()(T *p) const
+		{
+			void *mem = dynamic_cast<void*>(p); // the most derived object
+			p->~T();
+			if (!arena) ::operator delete(mem);
+		}
 	};
 
 	//===================================== Rmessage ---- QAP1 storage
@@ -117,20 +226,65 @@ namespace Rconnection2 {
 		
 		MessageBuffer() 
 		:
-			bytes_()
+			bytes_(),
+			arena_(),
+			decode_mtx_()
 		{
 		}
 
 		explicit MessageBuffer(size_t nbytes) 
 		: 
-			bytes_((nbytes / sizeof(buffer_element_type)) + ((nbytes % sizeof(buffer_element_type)) ? 1 : 0)) 
+			bytes_((nbytes / sizeof(buffer_element_type)) + ((nbytes % sizeof(buffer_element_type)) ? 1 : 0)),
+			arena_(),
+			decode_mtx_()
 		{
 		}
 
 		template<class T> T* get() const { return (T*)(&bytes_[0]); }
 
+		/** Rexp nodes decoded from this buffer are allocated in its arena once
+			enabled (done for all received messages) */
+		void enable_arena() { arena_.enable(); }
+		RexpArena *arena() { return arena_.enabled() ? &arena_ : NULL; }
+
+		/** held while a lazily decoded node creates one of its parts */
+		std::mutex& decode_mutex() { return decode_mtx_; }
+
 	private:
 		std::vector<buffer_element_type> bytes_;
+		RexpArena arena_;
+		std::mutex decode_mtx_;
+	};
+
+	/** memory for one decoded node, from the arena of buffer if it has one and
+		from the heap otherwise. given back when it goes out of scope, unless
+		Rexp::adopt() took over the node constructed in it */
+	class RexpNodeMemory
+	{
+	private:
+		explicit RexpNodeMemory(const RexpNodeMemory&);
+		RexpNodeMemory& operator=(const RexpNodeMemory&);
+
+	public:
+		RexpNodeMemory(size_t n, const std::shared_ptr<MessageBuffer>& buffer)
+		:
+			buffer_(buffer),
+			arena_(buffer ? buffer->arena() : NULL),
+			p_(arena_ ? arena_->allocate(n) : ::operator new(n))
+		{
+		}
+
+		~RexpNodeMemory() { if (p_ && !arena_) ::operator delete(p_); }
+
+		void *get() const { return p_; }
+		RexpArena *arena() const { return arena_; }
+		const std::shared_ptr<MessageBuffer>& buffer() const { return buffer_; }
+		void release() { p_ = NULL; }
+
+	private:
+		std::shared_ptr<MessageBuffer> buffer_;
+		RexpArena *arena_;
+		void *p_;
 	};
 
 	class RCONNECTION2_API Rmessage
@@ -143,6 +297,13 @@ namespace Rconnection2 {
 		std::shared_ptr<MessageBuffer> data_;
 		int complete_;
 		Rsize_t len_;
+		Rsize_t rcvd_; // bytes received so far by feed()/commit_read()
+		char *ext_; // caller's payload buffer, see receive_into()
+		Rsize_t ext_cap_;
+		Rsize_t ext_head_;
+		Rsize_t head_len_; // leading payload bytes kept in head_
+		bool payload_ready_; // storage for the payload chosen, see prepare_payload()
+		unsigned int head_[4];
 
 		// the following is avaliable only for parsed messages (max 16 pars)
 		std::vector<unsigned int *>par_;
@@ -153,6 +314,13 @@ namespace Rconnection2 {
 			data_ = std::make_shared<MessageBuffer>(n);
 		}
 
+		/** buffer for a received payload, whose decoded nodes go to its arena */
+		void alloc_received(size_t n)
+		{
+			alloc_data_only(n);
+			data_->enable_arena();
+		}
+
 	protected:
 		Rmessage();
 		Rmessage(int cmd); // 0 data_
@@ -175,8 +343,8 @@ namespace Rconnection2 {
 		unsigned get_par(int index1, int index2) { return par_[index1][index2]; }
 		size_t get_par_count() const { return par_.size(); }
 		Rsize_t get_len() const { return len_; }
-		char* get_data() { return data_ ? data_->get<char>() : NULL; }
-		const char* get_data() const { return data_ ? data_->get<char>() : NULL; }
+		char* get_data() { return ext_ ? ext_ : (data_ ? data_->get<char>() : NULL); }
+		const char* get_data() const { return ext_ ? ext_ : (data_ ? data_->get<char>() : NULL); }
 		void alloc_data(size_t n)
 		{
 			alloc_data_only(n);
@@ -188,7 +356,87 @@ namespace Rconnection2 {
 		int read(IRconnection& conn);
 		void parse();
 
+		/* incremental reading for non-blocking transports: begin_read() resets
+		   the message, then feed() consumes bytes as they arrive and returns
+		   how many it used - it stops right after the header, so the caller
+		   can look at it (has_header()) and still choose where the payload
+		   goes. after that read_window() exposes the remaining payload area
+		   so it can be received into directly and accounted with
+		   commit_read(). is_complete() turns 1 at the end */
+		void begin_read();
+		int has_header() const { return rcvd_ >= sizeof(header_); }
+		/** the payload goes straight to buf if it is at most cap bytes long.
+			it is taken as raw bytes then (no parameters) and get_data() points
+			to buf, which must outlive the message. with head > 0 the payload
+			must be cap bytes plus 1 to head (max. 16) leading bytes instead,
+			which are kept in the message (get_head()). call before the first
+			byte of the payload is read */
+		void receive_into(char *buf, Rsize_t cap, Rsize_t head = 0)
+		{
+			ext_ = buf;
+			ext_cap_ = cap;
+			ext_head_ = std::min(head, (Rsize_t)sizeof(head_));
+		}
+		const unsigned int *get_head(Rsize_t& n) const
+		{
+			n = head_len_;
+			return head_;
+		}
+		size_t feed(const char *buf, size_t n);
+		char *read_window(Rsize_t& avail);
+		void commit_read(Rsize_t n);
+
 		int send(IRconnection& conn);
+
+	protected:
+		void check_read_complete();
+		/** picks the payload storage - the caller's buffer or a MessageBuffer */
+		void prepare_payload();
+	};
+
+	//===================================== RnameIndex --- by-name lookups
+
+	/* name -> position index behind Rstrings::indexOfString(),
+	   Rvector::indexOfString() and Rlist::entryByTagName(), built on the
+	   first lookup of a long enough object. keys point to strings owned by
+	   the indexed object, the first occurrence of a name wins */
+	class RCONNECTION2_API RnameIndex
+	{
+	public:
+		RnameIndex() : map_() {}
+
+		void reserve(size_t n) { map_.reserve(n); }
+		void add(const char *name, size_t len, size_t pos) { map_.insert(std::make_pair(Key(name, len), pos)); }
+		void add(const char *name, size_t pos) { add(name, strlen(name), pos); }
+		/** std::string::npos if not found */
+		size_t find(const char *name) const
+		{
+			auto it = map_.find(Key(name, strlen(name)));
+			return it == map_.end() ? std::string::npos : it->second;
+		}
+
+	private:
+		struct Key
+		{
+			const char *s;
+			size_t len;
+			Key(const char *s_, size_t len_) : s(s_), len(len_) {}
+			bool operator==(const Key& k) const { return len == k.len && !memcmp(s, k.s, len); }
+		};
+
+		struct KeyHash
+		{
+			size_t operator()(const Key& k) const
+			{
+				// FNV-1a
+				uint32_t h = 2166136261u;
+				for (size_t i = 0; i < k.len; ++i)
+					h = (h ^ (unsigned char)k.s[i]) * 16777619u;
+				return h;
+			}
+		};
+
+		std::unordered_map<Key, size_t, KeyHash> map_;
 	};
 
 	//===================================== Rexp --- basis for all SEXPs
@@ -213,24 +461,49 @@ namespace Rconnection2 {
 
 	protected:
 		explicit Rexp(const std::shared_ptr<Rmessage>& msg);
-		Rexp(const unsigned int *pos, const std::shared_ptr<MessageBuffer>& buffer);
+		Rexp(const unsigned int *pos, const std::shared_ptr<MessageBuffer>& buffer, bool lazy = false);
 		Rexp(int type, const char *data = 0, Rsize_t = 0, std::shared_ptr<Rexp> attr = std::shared_ptr<Rexp>());
 		
 		template<class V, class Extractor>
 		void initFromContainer(const std::vector<V>& data, const Extractor& extractor);
 		
 		virtual void fix_content() {}
-		char *parseBytes(const unsigned int *pos);
-		static std::shared_ptr<Rexp> createFromBytes(const unsigned int *d, const std::shared_ptr<MessageBuffer>& buffer);
+		char *parseBytes(const unsigned int *pos, bool lazy = false);
+		static std::shared_ptr<Rexp> createFromBytes(const unsigned int *d, const std::shared_ptr<MessageBuffer>& buffer,
+			bool lazy = false);
+		/** end of the encoded SEXP at pos, without parsing it */
+		static char *skipBytes(const unsigned int *pos);
+
+		/* XT_ARRAY_BOOL and XT_RAW carry int(n) in front of their n bytes */
+
+		/** allocates the payload for n bytes, writes the count and padding
+			and returns where the bytes go */
+		char *initCounted(Rsize_t n, unsigned char pad);
+		/** the count of a received payload, 0 if it does not fit */
+		Rsize_t countedLength() const;
+
+		/** takes ownership of a node constructed in mem. the deleter always
+			matches how mem was obtained, nodes are never freed by delete */
+		template<class T> static std::shared_ptr<T> adopt(T *p, RexpNodeMemory& mem)
+		{
+			mem.release();
+			RexpArena *arena = mem.arena();
+			if (!arena)
+				return std::shared_ptr<T>(p, RexpArenaDeleter(NULL), std::allocator<T>());
+			return std::shared_ptr<T>(p, RexpArenaDeleter(arena),
+				RexpArenaAllocator<T>(std::shared_ptr<RexpArena>(mem.buffer(), arena)));
+		}
 
 	public:
-		static std::shared_ptr<Rexp> create(const std::shared_ptr<Rmessage>& msg);
+		/** lazy: vectors and lists create their elements only on first access */
+		static std::shared_ptr<Rexp> create(const std::shared_ptr<Rmessage>& msg, bool lazy = false);
 
 		static std::shared_ptr<Rexp> create(const unsigned int *pos, 
 			std::shared_ptr<Rmessage> msg = std::shared_ptr<Rmessage>())
 		{
-			return std::shared_ptr<Rexp>(new Rexp(pos, msg ? msg->get_buffer() 
-				: std::shared_ptr<MessageBuffer>()));
+			std::shared_ptr<MessageBuffer> buffer = msg ? msg->get_buffer() : std::shared_ptr<MessageBuffer>();
+			RexpNodeMemory mem(sizeof(Rexp), buffer);
+			return adopt(new (mem.get()) Rexp(pos, buffer), mem);
 		}
 
 		static std::shared_ptr<Rexp> create(int type, const char *data = 0, Rsize_t len = 0, 
@@ -246,9 +519,18 @@ namespace Rconnection2 {
 		virtual Rsize_t storageSize() const { return len_ + ((len_ > 0x7fffff) ? 8 : 4); }
 
 		virtual void store(char *buf) const;
+
+		/** zero-copy variant of store(): writes only the SEXP header into hdrbuf
+			(at least 12 bytes) and fills segs[0..2] with the header and the
+			payload, the latter referencing data_ in place. returns the number
+			of segments used */
+		virtual int storeSegments(char *hdrbuf, IoSegment *segs) const;
 		std::shared_ptr<Rexp> attribute(const char *name) const;
 		const std::vector<std::string>& attributeNames() const;
 		char* get_next() const { return next_; }
+		/** the payload without header and attributes, byteLength() bytes */
+		const char *get_data() const { return data_; }
+		Rsize_t byteLength() const { return len_; }
 
 		virtual Rsize_t length() { return len_; }
 
@@ -310,7 +592,8 @@ namespace Rconnection2 {
 
 		static std::shared_ptr<Rinteger> create(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer)
 		{
-			auto p = std::shared_ptr<Rinteger>(new Rinteger(ipos, buffer));
+			RexpNodeMemory mem(sizeof(Rinteger), buffer);
+			auto p = adopt(new (mem.get()) Rinteger(ipos, buffer), mem);
 			p->fix_content();
 			return p;
 		}
@@ -386,7 +669,8 @@ namespace Rconnection2 {
 
 		static std::shared_ptr<Rdouble> create(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer)
 		{
-			auto p = std::shared_ptr<Rdouble>(new Rdouble(ipos, buffer));
+			RexpNodeMemory mem(sizeof(Rdouble), buffer);
+			auto p = adopt(new (mem.get()) Rdouble(ipos, buffer), mem);
 			p->fix_content();
 			return p;
 		}
@@ -426,6 +710,196 @@ namespace Rconnection2 {
 		}
 	};
 
+	//===================================== Rlogical --- XT_ARRAY_BOOL
+
+	/** logical values are bytes: 0 = FALSE, 1 = TRUE, NA_LOGICAL_BYTE = NA */
+#define NA_LOGICAL_BYTE 2
+
+	class RCONNECTION2_API Rlogical : public Rexp {
+	protected:
+		Rsize_t count_;
+
+		Rlogical(const std::shared_ptr<Rmessage>& msg) : Rexp(msg), count_(0) { }
+		Rlogical(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer) : Rexp(ipos, buffer), count_(0) { }
+		Rlogical(const unsigned char *values, int count);
+		Rlogical(const std::vector<bool>& values);
+		virtual void fix_content();
+
+	public:
+		static std::shared_ptr<Rlogical> create(const std::shared_ptr<Rmessage>& msg)
+		{
+			auto p = std::shared_ptr<Rlogical>(new Rlogical(msg));
+			p->fix_content();
+			return p;
+		}
+
+		static std::shared_ptr<Rlogical> create(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer)
+		{
+			RexpNodeMemory mem(sizeof(Rlogical), buffer);
+			auto p = adopt(new (mem.get()) Rlogical(ipos, buffer), mem);
+			p->fix_content();
+			return p;
+		}
+
+		/** values are 0, 1 or NA_LOGICAL_BYTE */
+		static std::shared_ptr<Rlogical> create(const unsigned char *values, int count)
+		{
+			auto p = std::shared_ptr<Rlogical>(new Rlogical(values, count));
+			p->fix_content();
+			return p;
+		}
+
+		static std::shared_ptr<Rlogical> create(const std::vector<bool>& values)
+		{
+			auto p = std::shared_ptr<Rlogical>(new Rlogical(values));
+			p->fix_content();
+			return p;
+		}
+
+		virtual ~Rlogical() {}
+
+		/** points into the buffer */
+		const unsigned char *logicalArray() const { return data_ ? (const unsigned char*)data_ + 4 : NULL; }
+		/** NA_LOGICAL_BYTE if out of range, like R */
+		unsigned char logicalAt(int pos) const { return (pos >= 0 && (Rsize_t)pos < count_) ? logicalArray()[pos] : NA_LOGICAL_BYTE; }
+		bool isNA(int pos) const { return logicalAt(pos) == NA_LOGICAL_BYTE; }
+		Rsize_t count() const { return count_; }
+		virtual Rsize_t length() { return count_; }
+
+		virtual std::ostream& os_print(std::ostream& os)
+		{
+			return os << "Rlogical[" << count_ << "]";
+		}
+	};
+
+	//===================================== Rraw --- XT_RAW
+
+	class RCONNECTION2_API Rraw : public Rexp {
+	protected:
+		Rsize_t count_;
+		unsigned char *bytes_;
+		// set if bytes_ is not in the buffer but referenced from the creator
+		std::shared_ptr<const void> external_;
+
+		Rraw(const std::shared_ptr<Rmessage>& msg) : Rexp(msg), count_(0), bytes_(NULL), external_() { }
+		Rraw(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer) : Rexp(ipos, buffer), count_(0), bytes_(NULL), external_() { }
+		Rraw(const void *data, Rsize_t n);
+		Rraw(const std::shared_ptr<const void>& owner, const void *data, Rsize_t n);
+		virtual void fix_content();
+
+	public:
+		static std::shared_ptr<Rraw> create(const std::shared_ptr<Rmessage>& msg)
+		{
+			auto p = std::shared_ptr<Rraw>(new Rraw(msg));
+			p->fix_content();
+			return p;
+		}
+
+		static std::shared_ptr<Rraw> create(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer)
+		{
+			RexpNodeMemory mem(sizeof(Rraw), buffer);
+			auto p = adopt(new (mem.get()) Rraw(ipos, buffer), mem);
+			p->fix_content();
+			return p;
+		}
+
+		/** copies n bytes, or zero-fills them if data is NULL so the
+			caller can write them through rawArray() */
+		static std::shared_ptr<Rraw> create(const void *data, Rsize_t n)
+		{
+			auto p = std::shared_ptr<Rraw>(new Rraw(data, n));
+			p->fix_content();
+			return p;
+		}
+
+		static std::shared_ptr<Rraw> create(const std::vector<unsigned char>& data)
+		{
+			return create(data.empty() ? NULL : &data[0], data.size());
+		}
+
+		/** references n bytes at data without copying - they are sent straight
+			from there. owner keeps them alive as long as the Rraw (and any
+			message it is queued in) exists. without an owner the bytes are
+			copied, as by create(data, n) */
+		static std::shared_ptr<Rraw> create(const std::shared_ptr<const void>& owner, const void *data, Rsize_t n)
+		{
+			if (!owner) return create(data, n);
+			auto p = std::shared_ptr<Rraw>(new Rraw(owner, data, n));
+			p->fix_content();
+			return p;
+		}
+
+		virtual ~Rraw() {}
+
+		/** points into the buffer, or at the referenced bytes */
+		unsigned char *rawArray() { return bytes_; }
+		const unsigned char *rawArray() const { return bytes_; }
+		Rsize_t count() const { return count_; }
+		virtual Rsize_t length() { return count_; }
+
+		virtual void store(char *buf) const;
+		virtual int storeSegments(char *hdrbuf, IoSegment *segs) const;
+
+		virtual std::ostream& os_print(std::ostream& os)
+		{
+			return os << "Rraw[" << count_ << "]";
+		}
+	};
+
+	//===================================== Rcomplex --- XT_ARRAY_CPLX
+
+	class RCONNECTION2_API Rcomplex : public Rexp {
+	protected:
+		Rcomplex(const std::shared_ptr<Rmessage>& msg) : Rexp(msg) { }
+		Rcomplex(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer) : Rexp(ipos, buffer) {}
+		Rcomplex(const std::complex<double> *array, int count) : Rexp(XT_ARRAY_CPLX, (char*)array, count*sizeof(std::complex<double>)) {}
+		Rcomplex(const std::vector<std::complex<double> >& array)
+			: Rexp(XT_ARRAY_CPLX, (char*)array.data(), array.size()*sizeof(std::complex<double>)) {}
+		virtual void fix_content();
+
+	public:
+		static std::shared_ptr<Rcomplex> create(const std::shared_ptr<Rmessage>& msg)
+		{
+			auto p = std::shared_ptr<Rcomplex>(new Rcomplex(msg));
+			p->fix_content();
+			return p;
+		}
+
+		static std::shared_ptr<Rcomplex> create(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer)
+		{
+			RexpNodeMemory mem(sizeof(Rcomplex), buffer);
+			auto p = adopt(new (mem.get()) Rcomplex(ipos, buffer), mem);
+			p->fix_content();
+			return p;
+		}
+
+		static std::shared_ptr<Rcomplex> create(const std::complex<double> *array, int count)
+		{
+			auto p = std::shared_ptr<Rcomplex>(new Rcomplex(array, count));
+			p->fix_content();
+			return p;
+		}
+
+		static std::shared_ptr<Rcomplex> create(const std::vector<std::complex<double> >& array)
+		{
+			auto p = std::shared_ptr<Rcomplex>(new Rcomplex(array));
+			p->fix_content();
+			return p;
+		}
+
+		virtual ~Rcomplex() {}
+
+		/** (Re, Im) pairs in the buffer, laid out as std::complex<double> */
+		std::complex<double> *complexArray() { return (std::complex<double>*)data_; }
+		std::complex<double> complexAt(int pos) { return (pos >= 0 && (unsigned)pos < len_ / 16) ? complexArray()[pos] : std::complex<double>(); }
+		virtual Rsize_t length() { return len_ / 16; }
+
+		virtual std::ostream& os_print(std::ostream& os)
+		{
+			return os << "Rcomplex[" << (len_ / 16) << "]";
+		}
+	};
+
 	//===================================== Rsymbol --- XT_SYM
 
 	class RCONNECTION2_API Rsymbol : public Rexp
@@ -446,7 +920,8 @@ namespace Rconnection2 {
 
 		static std::shared_ptr<Rsymbol> create(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer)
 		{
-			auto p = std::shared_ptr<Rsymbol>(new Rsymbol(ipos, buffer));
+			RexpNodeMemory mem(sizeof(Rsymbol), buffer);
+			auto p = adopt(new (mem.get()) Rsymbol(ipos, buffer), mem);
 			p->fix_content();
 			return p;
 		}
@@ -461,6 +936,17 @@ namespace Rconnection2 {
 		}
 	};
 
+	/** a string inside a message buffer, not copied. data is NULL for NA */
+	struct RCONNECTION2_API RstringRef
+	{
+		const char *data;
+		Rsize_t size;
+
+		bool isNA() const { return data == NULL; }
+		std::string str() const { return data ? std::string(data, size) : std::string(); }
+		bool equals(const char *s) const { return data && !strncmp(data, s, size) && !s[size]; }
+	};
+
 	//===================================== Rstrings --- XT_ARRAY_STR
 	// NOTE: XT_ARRAY_STR is new in 0103 and ths class is just a
 	//       very crude implementation. It replaces Rstring because
@@ -470,11 +956,15 @@ namespace Rconnection2 {
 	{
 	protected:
 		std::vector<const char*> cont_;
+		std::vector<Rsize_t> lens_;
+		mutable std::once_flag index_once_;
+		mutable std::unique_ptr<RnameIndex> index_;
 
-		Rstrings(const std::shared_ptr<Rmessage>& msg) : Rexp(msg), cont_() {}
-		Rstrings(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer) : Rexp(ipos, buffer), cont_() 
+		Rstrings(const std::shared_ptr<Rmessage>& msg) : Rexp(msg), cont_(), lens_(), index_once_(), index_() {}
+		Rstrings(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer) : Rexp(ipos, buffer), cont_(), lens_(), index_once_(), index_()
 {}
 		virtual void fix_content();
+		void addString(const char *c, const char *z);
 
 	public:
 		static std::shared_ptr<Rstrings> create(const std::shared_ptr<Rmessage>& msg)
@@ -486,24 +976,43 @@ namespace Rconnection2 {
 
 		static std::shared_ptr<Rstrings> create(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer)
 		{
-			auto p = std::shared_ptr<Rstrings>(new Rstrings(ipos, buffer));
+			RexpNodeMemory mem(sizeof(Rstrings), buffer);
+			auto p = adopt(new (mem.get()) Rstrings(ipos, buffer), mem);
 			p->fix_content();
 			return p;
 		}
 
 		static std::shared_ptr<Rstrings> create(const std::vector<std::string>& sv);
+		/** NULL entries are sent as NA */
+		static std::shared_ptr<Rstrings> create(const std::vector<const char*>& sv);
 
 		virtual ~Rstrings() {}
 
+		/** pointers into the message buffer, NULL for NA */
 		const std::vector<const char*>& strings() const { return cont_; }
-		std::string str(size_t i = 0) const { return cont_.at(i); }
+		/** empty for NA */
+		std::string str(size_t i = 0) const { return view(i).str(); }
+		RstringRef view(size_t i) const
+		{
+			RstringRef r = { cont_.at(i), lens_[i] };
+			return r;
+		}
+		bool isNA(size_t i) const { return cont_.at(i) == NULL; }
+		/** byte lengths of strings(), 0 for NA */
+		const std::vector<Rsize_t>& lengths() const { return lens_; }
 
 		unsigned int count() { return cont_.size(); }
-		int indexOfString(const char *str);
+		/** position of the first string equal to str, -1 if there is none.
+			long vectors are hashed on the first call, which makes further
+			lookups O(1); safe to call from several threads */
+		int indexOfString(const char *str) const;
 
 		virtual std::ostream& os_print(std::ostream& os)
 		{
-			return os << "char*[" << cont_.size() << "]\"" << str() << "\"..";
+			os << "char*[" << cont_.size() << "]";
+			if (cont_.empty()) return os;
+			if (isNA(0)) return os << "NA..";
+			return os << "\"" << cont_[0] << "\"..";
 		}
 	};
 
@@ -526,7 +1035,8 @@ namespace Rconnection2 {
 
 		static std::shared_ptr<Rstring> create(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer)
 		{
-			auto p = std::shared_ptr<Rstring>(new Rstring(ipos, buffer));
+			RexpNodeMemory mem(sizeof(Rstring), buffer);
+			auto p = adopt(new (mem.get()) Rstring(ipos, buffer), mem);
 			p->fix_content();
 			return p;
 		}
@@ -556,14 +1066,35 @@ namespace Rconnection2 {
 	class RCONNECTION2_API Rlist : public Rexp
 	{
 	protected:
-		std::shared_ptr<Rexp> head_, tag_, tail_;
+		mutable std::shared_ptr<Rexp> head_, tag_, tail_;
+
+		// lazy lists: encoded parts not created yet, NULL once they are.
+		// cleared with release order after the part is stored, see loadHead()
+		bool lazy_;
+		mutable std::atomic<const unsigned int*> head_pos_, tag_pos_;
+		mutable std::atomic<char*> tail_pos_;
+		char *eod_;
 
-		Rlist(const std::shared_ptr<Rmessage>& msg) : Rexp(msg), head_(), tag_(), tail_() {}
+		// tag index of this node and its tails, see entryByTagName()
+		mutable std::once_flag index_once_;
+		mutable std::unique_ptr<RnameIndex> index_;
+		mutable std::vector<const Rlist*> index_nodes_;
 
-		Rlist(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer) 
+		Rlist(const std::shared_ptr<Rmessage>& msg)
+			:
+			Rexp(msg),
+			head_(), tag_(), tail_(),
+			lazy_(false), head_pos_(NULL), tag_pos_(NULL), tail_pos_(NULL), eod_(NULL),
+			index_once_(), index_(), index_nodes_()
+		{
+		}
+
+		Rlist(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer, bool lazy = false)
 		: 
-			Rexp(ipos, buffer), 
-			head_(), tag_(), tail_()
+			Rexp(ipos, buffer, lazy), 
+			head_(), tag_(), tail_(),
+			lazy_(lazy), head_pos_(NULL), tag_pos_(NULL), tail_pos_(NULL), eod_(NULL),
+			index_once_(), index_(), index_nodes_()
 		{
 		}
 
@@ -577,11 +1108,32 @@ namespace Rconnection2 {
 			Rexp(type, 0, 0),
 			head_(head),
 			tag_(tag),
-			tail_()
+			tail_(),
+			lazy_(false), head_pos_(NULL), tag_pos_(NULL), tail_pos_(NULL), eod_(NULL),
+			index_once_(), index_(), index_nodes_()
 		{
 			next_ = next;
 		}
 
+		/* a lazy tail node: the entry at ptr and everything up to eod */
+		Rlist(int type, char *ptr, char *eod, const std::shared_ptr<MessageBuffer>& buffer)
+			:
+			Rexp(type, 0, 0),
+			head_(), tag_(), tail_(),
+			lazy_(true), head_pos_(NULL), tag_pos_(NULL), tail_pos_(NULL), eod_(eod),
+			index_once_(), index_(), index_nodes_()
+		{
+			buffer_ = buffer;
+			next_ = setLazyEntry(ptr);
+		}
+
+		char *setLazyEntry(char *ptr);
+		void loadHead() const;
+		void loadTag() const;
+		void loadTail() const;
+		void buildIndex() const;
+		static const char *tagName(const std::shared_ptr<Rexp>& tag);
+
 	public:
 		static std::shared_ptr<Rlist> create(const std::shared_ptr<Rmessage>& msg)
 		{
@@ -590,9 +1142,11 @@ namespace Rconnection2 {
 			return p;
 		}
 
-		static std::shared_ptr<Rlist> create(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer)
+		static std::shared_ptr<Rlist> create(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer,
+			bool lazy = false)
 		{
-			auto p = std::shared_ptr<Rlist>(new Rlist(ipos, buffer));
+			RexpNodeMemory mem(sizeof(Rlist), buffer);
+			auto p = adopt(new (mem.get()) Rlist(ipos, buffer, lazy), mem);
 			p->fix_content();
 			return p;
 		}
@@ -607,28 +1161,23 @@ namespace Rconnection2 {
 
 		virtual ~Rlist() {}
 
-		std::shared_ptr<Rexp> get_head() const { return head_; }
-		std::shared_ptr<Rexp> get_tail() const { return tail_; }
-		std::shared_ptr<Rexp> get_tag() const { return tag_; }
+		std::shared_ptr<Rexp> get_head() const { if (head_pos_.load(std::memory_order_acquire)) loadHead(); return head_; }
+		std::shared_ptr<Rexp> get_tail() const { if (tail_pos_.load(std::memory_order_acquire)) loadTail(); return tail_; }
+		std::shared_ptr<Rexp> get_tag() const { if (tag_pos_.load(std::memory_order_acquire)) loadTag(); return tag_; }
 
-		std::shared_ptr<Rexp> entryByTagName(const char *tagName)
-		{
-			if (tag_ && (tag_->get_type() == XT_SYM || tag_->get_type() == XT_SYMNAME)
-				&& !strcmp((static_cast<Rsymbol*>(tag_.get()))->symbolName(), tagName))
-				return head_;
-			else if (tail_)
-				return static_cast<Rlist*>(tail_.get())->entryByTagName(tagName);
-			else
-				return std::shared_ptr<Rexp>();
-		}
+		/** value of the first entry tagged tagName (from this node on). long
+			lists are hashed on the first call, which makes further lookups
+			O(1); safe to call from several threads */
+		std::shared_ptr<Rexp> entryByTagName(const char *tagName) const;
 
 		virtual std::ostream& os_print(std::ostream& os)
 		{
+			std::shared_ptr<Rexp> tag = get_tag(), head = get_head(), tail = get_tail();
 			os << "Rlist[tag=";
-			if (tag_) os << *tag_; else os << "<none>";
+			if (tag) os << *tag; else os << "<none>";
 			os << ",head_=";
-			if (head_) os << *head_; else os << "<none>";
-			if (tail_) os << ",tail=" << *tail_;
+			if (head) os << *head; else os << "<none>";
+			if (tail) os << ",tail=" << *tail;
 			return os << "]";
 		}
 
@@ -642,28 +1191,51 @@ namespace Rconnection2 {
 	protected:
 		mutable std::vector< std::shared_ptr<Rexp> >cont_;
 
+		// lazy vectors: where the elements not created yet are encoded, NULL
+		// once they are (cleared like Rlist::head_pos_)
+		bool lazy_;
+		mutable std::vector< std::atomic<const unsigned int*> > lazy_pos_;
+
 		// cached
 		std::vector<std::string> strs_;
 		bool strs_populated_;
+		mutable std::once_flag index_once_;
+		mutable std::unique_ptr<RnameIndex> index_;
 
 		Rvector(const std::shared_ptr<Rmessage>& msg)
 			:
 			Rexp(msg),
 			cont_(),
+			lazy_(false),
+			lazy_pos_(),
 			strs_(),
-			strs_populated_(false)
+			strs_populated_(false),
+			index_once_(),
+			index_()
 		{
 		}
 
-		Rvector(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer)
+		Rvector(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer, bool lazy = false)
 			:
-			Rexp(ipos, buffer),
+			Rexp(ipos, buffer, lazy),
 			cont_(),
+			lazy_(lazy),
+			lazy_pos_(),
 			strs_(),
-			strs_populated_(false)
+			strs_populated_(false),
+			index_once_(),
+			index_()
 		{
 		}
 
+		const std::shared_ptr<Rexp>& element(size_t i) const
+		{
+			if (lazy_ && lazy_pos_[i].load(std::memory_order_acquire)) loadElement(i);
+			return cont_[i];
+		}
+		void loadElement(size_t i) const;
+		void loadAll() const;
+
 	public:
 		static std::shared_ptr<Rvector> create(const std::shared_ptr<Rmessage>& msg)
 		{
@@ -672,9 +1244,11 @@ namespace Rconnection2 {
 			return p;
 		}
 
-		static std::shared_ptr<Rvector> create(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer)
+		static std::shared_ptr<Rvector> create(const unsigned int *ipos, const std::shared_ptr<MessageBuffer>& buffer,
+			bool lazy = false)
 		{
-			auto p = std::shared_ptr<Rvector>(new Rvector(ipos, buffer));
+			RexpNodeMemory mem(sizeof(Rvector), buffer);
+			auto p = adopt(new (mem.get()) Rvector(ipos, buffer, lazy), mem);
 			p->fix_content();
 			return p;
 		}
@@ -683,18 +1257,22 @@ namespace Rconnection2 {
 
 		const std::vector<std::string>& strings();
 		size_t indexOf(const std::shared_ptr<Rexp>& exp) const;
+		/** position of the first XT_STR element equal to str, indexed like
+			Rstrings::indexOfString() */
 		size_t indexOfString(const char *str) const;
 		virtual Rsize_t length() { return (Rsize_t)cont_.size(); }
 
 		const char *stringAt(size_t i)
 		{
-			if (i >= cont_.size() || !cont_[i] || cont_[i]->get_type() != XT_STR) 
+			if (i >= cont_.size()) return 0;
+			const std::shared_ptr<Rexp>& p = element(i);
+			if (!p || p->get_type() != XT_STR) 
 				return 0;
 			else
-				return ((Rstring*)cont_[i].get())->c_str();
+				return ((Rstring*)p.get())->c_str();
 		}
 
-		std::shared_ptr<Rexp> elementAt(int i) { return cont_[i]; }
+		std::shared_ptr<Rexp> elementAt(int i) { return element(i); }
 		
 		template<class V> std::shared_ptr<V> byName(const char *name) const
 		{
@@ -702,10 +1280,13 @@ namespace Rconnection2 {
 			return std::shared_ptr<V>(p, static_cast<V*>(p.get()));
 		}
 		
+		/** element named name - the names attribute and the names themselves
+			are looked up through their indexes */
 		std::shared_ptr<Rexp> byName_Rexp(const char *name) const;
 
 		virtual std::ostream& os_print(std::ostream& os)
 		{
+			loadAll();
 			os << "Rvector[count=" << cont_.size() << ":";
 			int i = 0;
 			for (const auto& p : cont_)
@@ -720,10 +1301,181 @@ namespace Rconnection2 {
 		virtual void fix_content();
 	};
 
+	//===================================== Rprotocol ---- sans-I/O QAP1 state machine
+
+	/* Rprotocol contains everything about QAP1 except the actual I/O: the
+	   handshake (ID string), framing of incoming messages and encoding of
+	   outgoing requests. The driver moves the bytes:
+
+	   input:  p = readBuffer(avail); n = recv(s, p, avail); commitRead(n);
+	           then nextMessage() while hasMessage()
+	   output: encode...(); n = pendingOutput(segs, max); writev(segs, n);
+	           consumeOutput(bytes written)
+
+	   readBuffer() returns the internal read-ahead buffer, so one recv()
+	   usually brings in the header and a short payload together. While a
+	   large payload is outstanding it returns the message buffer itself, so
+	   big objects are received in place. Short outgoing segments are copied
+	   into the frame, larger ones are referenced in place and must stay
+	   valid until written - either through the owner passed to encode() or
+	   because the caller flushes before returning (as Rconnection does).
+
+	   Out-of-band frames never show up in nextMessage(): OOB_SEND payloads go
+	   to the registered handler, OOB_MSG is answered through the output queue
+	   (ahead of requests not started yet), so the driver must flush output
+	   after reading as well. */
+	class RCONNECTION2_API Rprotocol
+	{
+	public:
+		enum State { st_handshake, st_ready, st_failed };
+
+		/** OOB_SEND - an object pushed by R while a request is running (e.g. by
+			self.oobSend()). code is the application specific OOB_USR_CODE, exp
+			is NULL if the payload was not a SEXP */
+		typedef std::function<void(int code, const std::shared_ptr<Rexp>& exp)> OOBSendHandler;
+		/** OOB_MSG - R waits for the returned object (self.oobMessage()); a NULL
+			result answers with an empty RESP_OK */
+		typedef std::function<std::shared_ptr<Rexp>(int code, const std::shared_ptr<Rexp>& exp)> OOBMessageHandler;
+
+	protected:
+		enum Area { area_none, area_id, area_buffer, area_message };
+
+		struct Piece
+		{
+			const char *ext; // NULL - stored in Outgoing::inline_ at offset off
+			size_t off;
+			size_t len;
+		};
+
+		struct Outgoing
+		{
+			std::vector<char> inline_;
+			std::vector<Piece> pieces;
+			std::shared_ptr<const void> owner;
+			size_t total;
+		};
+
+		State state_;
+		int error_;
+		int auth_;
+		char salt_[2];
+		char idbuf_[32];
+		size_t idlen_;
+
+		std::vector<char> rbuf_;
+		Area area_;
+		std::shared_ptr<Rmessage> inmsg_;
+		struct Sink
+		{
+			char *buf;
+			Rsize_t cap;
+			Rsize_t head;
+		};
+		std::deque<Sink> sinks_; // see receiveInto()
+		std::deque< std::shared_ptr<Rmessage> > received_;
+
+		std::deque<Outgoing> outq_;
+		size_t out_off_; // bytes of outq_.front() already consumed
+		size_t out_locked_; // bytes after out_off_ owned by an asynchronous send
+
+		OOBSendHandler on_oob_send_;
+		OOBMessageHandler on_oob_msg_;
+
+		int setError(int err);
+		int deliver(const std::shared_ptr<Rmessage>& msg);
+		/** urgent frames go ahead of everything not started yet */
+		int append(int cmd, const char *head, size_t hlen, const IoSegment *segs, int count,
+			const std::shared_ptr<const void>& owner, bool urgent = false);
+		int appendSEXP(int cmd, const Rexp& exp, const std::shared_ptr<const void>& owner, bool urgent);
+		void appendPiece(Outgoing& o, const char *data, size_t len, bool copy);
+
+	public:
+		explicit Rprotocol(bool expect_id = true);
+
+		/** back to the initial state, dropping all buffered data. expect_id is
+			false when resuming a session, where the server sends no ID string */
+		void reset(bool expect_id = true);
+
+		State state() const { return state_; }
+		int error() const { return error_; }
+		int auth() const { return auth_; }
+		const char *salt() const { return salt_; }
+
+		/** handlers are kept across reset(). without an OOB_MSG handler the
+			server gets RESP_ERR, unhandled OOB_SEND frames are dropped. they
+			run from commitRead()/feed() and must not drive the connection */
+		void setOOBHandlers(const OOBSendHandler& on_send, const OOBMessageHandler& on_msg)
+		{
+			on_oob_send_ = on_send;
+			on_oob_msg_ = on_msg;
+		}
+
+		/* --- input --- */
+
+		/** area where the next received bytes should be stored, never NULL
+			unless the protocol has failed */
+		char *readBuffer(size_t& avail);
+		/** accounts n bytes stored into the last readBuffer(). returns 0 or
+			an error code (ID string check) */
+		int commitRead(size_t n);
+		/** copies bytes in - for drivers that own their receive buffers */
+		int feed(const char *buf, size_t n);
+		/** the message the next readBuffer() stores into directly, NULL if it
+			returns an internal buffer. drivers whose reads may outlive a
+			reset() keep it alive until the read completes */
+		std::shared_ptr<Rmessage> inPlaceTarget() const;
+		/** the payload of the next message not started yet is received into
+			buf if it fits (Rmessage::receive_into). one call per expected
+			reply, in order; for raw replies such as CMD_readFile. OOB frames
+			arriving in between do not take a buffer */
+		void receiveInto(char *buf, Rsize_t cap, Rsize_t head = 0)
+		{
+			Sink k = { buf, cap, head };
+			sinks_.push_back(k);
+		}
+
+		bool hasMessage() const { return !received_.empty(); }
+		std::shared_ptr<Rmessage> nextMessage();
+
+		/* --- output --- */
+
+		int encode(int cmd, const IoSegment *segs, int count,
+			const std::shared_ptr<const void>& owner = std::shared_ptr<const void>());
+		int encode(const Rmessage& msg, const std::shared_ptr<const void>& owner = std::shared_ptr<const void>());
+		/** CMD_setSEXP with the Rexp payload referenced in place */
+		int encodeAssign(const char *symbol, const Rexp& exp,
+			const std::shared_ptr<const void>& owner = std::shared_ptr<const void>());
+
+		bool hasOutput() const { return !outq_.empty(); }
+		size_t outputSize() const;
+		/** fills up to max segments of pending output, starting at the first
+			unconsumed byte. returns the number of segments */
+		int pendingOutput(IoSegment *segs, int max) const;
+		void consumeOutput(size_t n);
+		/** the first n bytes of pendingOutput() were handed to a send that
+			completes later - urgent frames are queued behind them */
+		void lockOutput(size_t n) { out_locked_ = n; }
+	};
+
 	//===================================== Rconnection ---- Rserve interface class
 
 	class Rconnection;
 
+	// helpers shared by the blocking and the asynchronous client
+
+	/** checks the 32-byte ID string sent by the server and picks up the
+		authentication method and salt. returns 0, CERR_invalid_id or
+		CERR_protocol_not_supp */
+	RCONNECTION2_API int parseIDstring(const char *IDstring, int *auth, char *salt);
+
+	/** builds the "user\npwd" payload of CMD_login for the given auth method */
+	RCONNECTION2_API int buildLoginString(int auth, const char *salt, const char *user, const char *pwd, std::vector<char>& out);
+
+	/** extracts the single DT_SEXP parameter of an eval response. sets *status
+		to 0 or -12 if the response does not carry a SEXP */
+	RCONNECTION2_API std::shared_ptr<Rexp> decodeSEXPResponse(const std::shared_ptr<Rmessage>& msg, int *status,
+		bool lazy = false);
+
 	class RCONNECTION2_API Rsession
 	{
 	protected:
@@ -752,8 +1504,60 @@ namespace Rconnection2 {
 		const char *key() const { return key_; }
 	};
 
+	/** result of one expression of Rconnection::evalBatch() */
+	struct RCONNECTION2_API RbatchResult
+	{
+		int status;                  // 0 or CERR_eval_failed
+		std::shared_ptr<Rexp> value; // NULL if the evaluation failed
+		std::string error;           // message of the R error
+	};
+
+	/** buffer sizes of an Rconnection; explicit values are applied as given,
+		0 leaves them to the OS/server or - if adaptive is set - to the
+		connection, which grows them from the observed payload sizes and the
+		measured bandwidth-delay product */
+	struct RCONNECTION2_API RtransportOptions
+	{
+		int sndbuf;         // SO_SNDBUF
+		int rcvbuf;         // SO_RCVBUF
+		int server_buffer;  // Rserve send buffer, CMD_setBufferSize
+		bool adaptive;
+		int max_buffer;     // upper limit of adaptive sizes
+
+		RtransportOptions() : sndbuf(0), rcvbuf(0), server_buffer(0), adaptive(false), max_buffer(64 * 1024 * 1024) {}
+	};
+
+	struct RCONNECTION2_API RtransportStats
+	{
+		uint64_t bytes_sent;
+		uint64_t bytes_received;
+		Rsize_t largest_request;
+		Rsize_t largest_reply;
+
+		// transfers of large messages only, so server compute time is not included
+		uint64_t bulk_bytes_sent;
+		double bulk_send_seconds;
+		uint64_t bulk_bytes_received;
+		double bulk_receive_seconds;
+
+		unsigned int rtt_us;    // TCP RTT (TCP_INFO) or the fastest small round trip, 0 = unknown
+		int sndbuf;             // current sizes
+		int rcvbuf;
+		int server_buffer;      // last size the server accepted via CMD_setBufferSize, 0 = server default
+
+		/** achieved throughput in bytes per second */
+		double send_throughput() const { return bulk_send_seconds > 0.0 ? bulk_bytes_sent / bulk_send_seconds : 0.0; }
+		double receive_throughput() const { return bulk_receive_seconds > 0.0 ? bulk_bytes_received / bulk_receive_seconds : 0.0; }
+	};
+
 	class RCONNECTION2_API Rconnection: public IRconnection
 	{
+	public:
+		// callbacks of the pipelined requests
+		typedef std::function<void(int status)> StatusCallback;
+		typedef std::function<void(int status, const std::shared_ptr<Rexp>& exp)> EvalCallback;
+		typedef std::function<void(int status, const std::shared_ptr<Rmessage>& msg)> MessageCallback;
+
 	protected:
 		std::string host_;
 		int  port_;
@@ -763,6 +1567,34 @@ namespace Rconnection2 {
 		char salt_[2];
 		std::vector<char> session_key_;
 
+		Rprotocol proto_;
+
+		struct PipedRequest
+		{
+			MessageCallback done;
+			size_t bytes;
+		};
+		std::deque<PipedRequest> piped_; // in submission order
+		size_t piped_bytes_;
+		size_t pipe_limit_;
+		bool pipe_holding_;    // a new request waits for room, only pipe_admitted_ bytes may be written
+		size_t pipe_admitted_;
+		size_t pipe_done_;     // replies dispatched so far
+		bool pumping_;
+
+		// deadlines
+		int timeout_ms_;
+		int connect_timeout_ms_;
+		std::chrono::steady_clock::time_point deadline_;
+		bool deadline_set_;
+
+		// transport tuning
+		RtransportOptions topt_;
+		RtransportStats tstats_;
+		int server_buffer_asked_;          // last CMD_setBufferSize queued, 0 = none
+		int sndbuf_asked_, rcvbuf_asked_;  // the kernel may report more (Linux doubles)
+		unsigned int rtt_min_us_;
+
 		/** host - either host name or unix socket path
 			port - either TCP port or -1 if unix sockets should be used */
 		explicit Rconnection(const char *host = "127.0.0.1", int port = default_Rsrv_port);
@@ -787,7 +1619,37 @@ namespace Rconnection2 {
 		virtual int connect();
 		virtual bool disconnect();
 		virtual SOCKET getSocket() const { return s_; }
-		
+
+		/** handlers for out-of-band frames arriving while a request is running,
+			see Rprotocol. they are called from within the request and must not
+			use the connection themselves */
+		void setOOBHandlers(const Rprotocol::OOBSendHandler& on_send,
+			const Rprotocol::OOBMessageHandler& on_msg = Rprotocol::OOBMessageHandler())
+		{
+			proto_.setOOBHandlers(on_send, on_msg);
+		}
+
+		/** limits every blocking call (eval, assign, login, file I/O, pipeSync ...)
+			to timeout_ms, -1 = no limit. a call that runs out of time returns
+			CERR_timeout and closes the connection - the reply may still arrive
+			later, so the session cannot be used any more and must be discarded */
+		void setTimeout(int timeout_ms) { timeout_ms_ = timeout_ms; }
+		int timeout() const { return timeout_ms_; }
+
+		/** socket and server buffer sizes - socket buffers are best set before
+			connect(), where they also determine the TCP window scale. an explicit
+			server_buffer goes out ahead of the first request after login */
+		void setTransportOptions(const RtransportOptions& opt);
+		const RtransportOptions& transportOptions() const { return topt_; }
+		RtransportStats transportStats() const { return tstats_; }
+
+		/** CMD_setBufferSize - size of the buffer Rserve assembles replies in */
+		int setServerBufferSize(int size);
+
+		/** limits connect() including the handshake, -1 = no limit */
+		void setConnectTimeout(int timeout_ms) { connect_timeout_ms_ = timeout_ms; }
+		int connectTimeout() const { return connect_timeout_ms_; }
+
 		int getLastSocketError(char* buffer, size_t buffer_len, int options) const;
 
 		/** --- high-level functions --- */
@@ -804,6 +1666,11 @@ namespace Rconnection2 {
 			return voidEval(cmd.c_str());
 		}
 
+		/** opt: 1 = void eval, 2 = lazy decoding - elements of vectors and lists
+			are created on first access, which pays off for wide results of
+			which only a few elements are used. the elements are created under
+			a lock on first access, so the result may be read from several
+			threads like an eagerly decoded one */
 		template<class V> std::shared_ptr<V> eval(const char *cmd, int *status = 0, int opt = 0)
 		{
 			std::shared_ptr<Rexp> p = eval_to_Rexp(cmd, status, opt);
@@ -812,6 +1679,29 @@ namespace Rconnection2 {
 
 		std::shared_ptr<Rexp> eval_to_Rexp(const char *cmd, int *status, int opt);
 
+		/** evaluates cmd and returns the reply without decoding it, e.g. to be
+			read through RexpView::fromMessage(). NULL on failure */
+		std::shared_ptr<Rmessage> evalMessage(const char *cmd, int *status = 0);
+
+		/** evaluates cmd, whose result must be a double/integer vector of exactly
+			n elements, and receives the values straight into buf. returns 0, the
+			eval status or CERR_shape_mismatch for any other result - the reply
+			is consumed either way, but buf is undefined after an error. OOB
+			frames R sends while evaluating go to the OOB handlers as usual */
+		int evalInto(const char *cmd, double *buf, size_t n)
+		{
+			return evalIntoArray(cmd, XT_ARRAY_DOUBLE, (char*)buf, n, sizeof(double));
+		}
+		int evalInto(const char *cmd, int *buf, size_t n)
+		{
+			return evalIntoArray(cmd, XT_ARRAY_INT, (char*)buf, n, sizeof(int));
+		}
+
+		/** evaluates all expressions in a single request. R errors are caught per
+			expression and reported in the corresponding result, *status only
+			reflects the request itself. returns an empty vector on failure */
+		std::vector<RbatchResult> evalBatch(const std::vector<std::string>& exprs, int *status = 0);
+
 		int login(const char *user, const char *pwd);
 		int shutdown(const char *key);
 
@@ -823,6 +1713,17 @@ namespace Rconnection2 {
 		int closeFile();
 		int removeFile(const char *fn);
 
+		/* --- streaming file transfer: opens (or creates) the remote file, moves
+		       it in chunks of up to chunk bytes with depth requests in flight
+		       and closes it again. downloaded chunks are received straight into
+		       the buffer passed on to the destination. return the number of
+		       bytes transferred or a negative error code --- */
+
+		int64_t downloadFile(const char *fn, std::ostream& out, unsigned int chunk = 1024 * 1024, int depth = 4);
+		int64_t downloadFile(const char *fn, int fd, unsigned int chunk = 1024 * 1024, int depth = 4);
+		int64_t uploadFile(const char *fn, std::istream& in, unsigned int chunk = 1024 * 1024, int depth = 4);
+		int64_t uploadFile(const char *fn, int fd, unsigned int chunk = 1024 * 1024, int depth = 4);
+
 		/* session methods - results of detach [if not NULL] must be deleted by the caller when no longer needed! */
 		std::shared_ptr<Rsession> detachedEval(const char *cmd, int *status = 0);
 		std::shared_ptr<Rsession> detach(int *status = 0);
@@ -830,6 +1731,31 @@ namespace Rconnection2 {
 
 		int queryCustomStatus(bool& status); // [IP] our custom API
 
+		/* --- pipelining - the pipe...() calls queue a request and return
+		       right away; requests are written back to back and the replies
+		       are read in order and passed to the callbacks from pipeSync(),
+		       from later pipe...() calls or from the next blocking call,
+		       which waits for all queued replies first. callbacks may queue
+		       further pipelined requests but must not issue blocking calls.
+		       all return 0 if the request was queued --- */
+
+		int pipeRequest(const std::shared_ptr<Rmessage>& msg, const MessageCallback& done);
+		int pipeEval(const char *cmd, const EvalCallback& done);
+		int pipeVoidEval(const char *cmd, const StatusCallback& done);
+		int pipeAssign(const char *symbol, const std::shared_ptr<Rexp>& exp, const StatusCallback& done);
+
+		/** waits for the replies of all queued requests */
+		int pipeSync();
+		/** number of queued requests still waiting for their reply */
+		size_t pipePending() const { return piped_.size(); }
+
+		/** max. bytes of requests whose replies have not been read yet; a new
+			request waits for older replies until it fits (a single request
+			larger than the limit is sent alone). uploadFile()/downloadFile()
+			are bounded by their depth instead */
+		void setPipelineLimit(size_t bytes) { pipe_limit_ = bytes; }
+		size_t pipelineLimit() const { return pipe_limit_; }
+
 
 #ifdef CMD_ctrl
 		/* server control functions (need Rserve 0.6-0 or higher) */
@@ -842,6 +1768,34 @@ namespace Rconnection2 {
 
 		int request(Rmessage& msg, int cmd, Rsize_t len = 0, void *par = 0);
 		int request(Rmessage& targetMsg, Rmessage& contents);
+		int request(Rmessage& targetMsg, int cmd, const IoSegment *segs, int count);
+		int evalIntoArray(const char *cmd, int xt, char *buf, size_t n, size_t elt);
+
+		// blocking drivers of proto_
+		int receiveSome();
+		int flushOutput();
+		int readMessage(Rmessage& msg);
+		int transact(Rmessage& targetMsg);
+		void startDeadline(int timeout_ms);
+		int remainingMs() const;
+
+		void applySocketBuffers(int sndbuf, int rcvbuf);
+		void updateRtt();
+		void tuneTransport();
+		void queueServerBufferSize(int size);
+
+		// pipelining
+		int pipeSubmit(size_t bytes, const MessageCallback& done);
+		int pumpPipeline(size_t until, bool wait);
+		int sendAvailable(size_t max, size_t& written);
+		int drainPipeline();
+		void dropConnection(int status);
+
+		// streaming file transfer - sinks return false, sources -1 on failure
+		typedef std::function<bool(const char *buf, size_t len)> ChunkSink;
+		typedef std::function<int64_t(char *buf, size_t len)> ChunkSource;
+		int64_t streamDownload(const char *fn, const ChunkSink& put, unsigned int chunk, int depth);
+		int64_t streamUpload(const char *fn, const ChunkSource& get, unsigned int chunk, int depth);
 
 	};
 
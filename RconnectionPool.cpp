@@ -0,0 +1,347 @@
+/*
+ *  C++ Interface to Rserve - connection pool
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+#include "RconnectionPool.h"
+
+#include <algorithm>
+#include <cstring>
+
+// how often the maintenance thread looks at the pool if validation is off
+#define POOL_MAINTAIN_PERIOD_MS 1000
+
+namespace Rconnection2 {
+
+	typedef std::chrono::steady_clock pool_clock;
+
+	//===================================== RconnectionPool::Lease
+
+	void RconnectionPool::Lease::release()
+	{
+		if (!conn_) return;
+		std::shared_ptr<RconnectionPool> pool;
+		std::shared_ptr<Rconnection> conn;
+		pool.swap(pool_);
+		conn.swap(conn_);
+		bool broken = broken_;
+		broken_ = false;
+		pool->giveBack(conn, broken);
+	}
+
+	//===================================== RconnectionPool
+
+	RconnectionPool::RconnectionPool(const RpoolOptions& opt)
+		:
+		opt_(opt),
+		mtx_(),
+		available_(),
+		wake_(),
+		idle_(),
+		open_(0),
+		in_use_(0),
+		waiting_(0),
+		stopping_(false),
+		stats_(),
+		maintainer_()
+	{
+		memset(&stats_, 0, sizeof(stats_));
+		idle_.reserve(opt_.size);
+	}
+
+	std::shared_ptr<RconnectionPool> RconnectionPool::create(const RpoolOptions& opt)
+	{
+		std::shared_ptr<RconnectionPool> pool(new RconnectionPool(opt));
+		// warm up before anybody can check out; failures are retried by the maintenance thread
+		pool->refill();
+		pool->maintainer_ = std::thread(&RconnectionPool::maintain, pool.get());
+		return pool;
+	}
+
+	RconnectionPool::~RconnectionPool()
+	{
+		shutdown();
+	}
+
+	void RconnectionPool::shutdown()
+	{
+		std::vector<Idle> idle;
+		{
+			std::lock_guard<std::mutex> lk(mtx_);
+			stopping_ = true;
+			idle.swap(idle_);
+			open_ -= idle.size();
+		}
+		available_.notify_all();
+		wake_.notify_all();
+		if (maintainer_.joinable() && maintainer_.get_id() != std::this_thread::get_id())
+			maintainer_.join();
+		// idle connections are closed as the vector goes out of scope
+	}
+
+	// the shorter of two timeouts, -1 being no limit
+	static int boundTimeout(int timeout_ms, int limit_ms)
+	{
+		if (limit_ms < 0) return timeout_ms;
+		return (timeout_ms < 0 || timeout_ms > limit_ms) ? limit_ms : timeout_ms;
+	}
+
+	std::shared_ptr<Rconnection> RconnectionPool::open(int *status, int limit_ms)
+	{
+		if (opt_.factory)
+			return opt_.factory(status);
+
+		std::shared_ptr<Rconnection> conn = Rconnection::create(opt_.host.c_str(), opt_.port);
+		conn->setConnectTimeout(boundTimeout(opt_.connect_timeout_ms, limit_ms));
+		conn->setTimeout(boundTimeout(opt_.call_timeout_ms, limit_ms));
+		int res = conn->connect();
+		if (!res && !opt_.user.empty())
+			res = conn->login(opt_.user.c_str(), opt_.pwd.c_str());
+		if (res)
+		{
+			if (status) *status = res;
+			return std::shared_ptr<Rconnection>();
+		}
+		conn->setConnectTimeout(opt_.connect_timeout_ms);
+		conn->setTimeout(opt_.call_timeout_ms);
+		return conn;
+	}
+
+	void RconnectionPool::refill()
+	{
+		std::unique_lock<std::mutex> lk(mtx_);
+		while (!stopping_ && open_ < opt_.size)
+		{
+			++open_;
+			lk.unlock();
+			int res = CERR_connect_failed;
+			// bounded, shutdown() has to wait for it
+			std::shared_ptr<Rconnection> conn = open(&res, opt_.validate_timeout_ms);
+			lk.lock();
+			if (!conn)
+			{
+				--open_;
+				++stats_.failures;
+				break; // the endpoint is down, try again next round
+			}
+			++stats_.created;
+			if (stopping_)
+			{
+				--open_;
+				break;
+			}
+			Idle i = { conn, pool_clock::now() };
+			idle_.push_back(i);
+			available_.notify_one();
+		}
+	}
+
+	void RconnectionPool::maintain()
+	{
+		const int period = (opt_.validate_idle_ms > 0) ?
+			std::max(opt_.validate_idle_ms / 2, 10) : POOL_MAINTAIN_PERIOD_MS;
+		std::unique_lock<std::mutex> lk(mtx_);
+		while (!stopping_)
+		{
+			wake_.wait_for(lk, std::chrono::milliseconds(period));
+			if (stopping_) break;
+
+			if (opt_.validate_idle_ms > 0 && !idle_.empty())
+			{
+				// take the stale ones out so checkout() cannot hand them out while being checked
+				pool_clock::time_point limit = pool_clock::now() - std::chrono::milliseconds(opt_.validate_idle_ms);
+				std::vector<Idle> stale;
+				size_t keep = 0;
+				for (size_t i = 0; i < idle_.size(); ++i)
+				{
+					if (idle_[i].since <= limit)
+						stale.push_back(idle_[i]);
+					else
+						idle_[keep++] = idle_[i];
+				}
+				idle_.resize(keep);
+
+				if (!stale.empty())
+				{
+					lk.unlock();
+					std::vector<Idle> good;
+					size_t bad = 0;
+					for (auto& i : stale)
+					{
+						// a hung server must not keep shutdown() waiting for the probe
+						const int call_timeout = i.conn->timeout();
+						i.conn->setTimeout(boundTimeout(call_timeout, opt_.validate_timeout_ms));
+						int res;
+						if (opt_.validator)
+							res = opt_.validator(*i.conn);
+						else
+						{
+							bool st;
+							i.conn->queryCustomStatus(st);
+							// stock Rserve refuses the custom command, only a lost socket counts
+							res = (i.conn->getSocket() == -1) ? CERR_not_connected : 0;
+						}
+						i.conn->setTimeout(call_timeout);
+						if (res || i.conn->getSocket() == -1)
+						{
+							++bad;
+							i.conn->disconnect();
+						}
+						else
+						{
+							i.since = pool_clock::now();
+							good.push_back(i);
+						}
+					}
+					lk.lock();
+					// validated connections go to the bottom of the stack, they are the coldest
+					idle_.insert(idle_.begin(), good.begin(), good.end());
+					open_ -= bad;
+					stats_.evicted += bad;
+					if (!good.empty()) available_.notify_all();
+					if (stopping_)
+					{
+						open_ -= idle_.size();
+						idle_.clear();
+						break;
+					}
+				}
+			}
+
+			if (open_ < opt_.size)
+			{
+				lk.unlock();
+				refill();
+				lk.lock();
+			}
+		}
+	}
+
+	void RconnectionPool::giveBack(const std::shared_ptr<Rconnection>& conn, bool broken)
+	{
+		std::unique_lock<std::mutex> lk(mtx_);
+		--in_use_;
+		if (broken || stopping_ || conn->getSocket() == -1)
+		{
+			--open_;
+			if (!stopping_) ++stats_.evicted;
+			lk.unlock();
+			conn->disconnect();
+			// a slot is free - a waiter may open a new connection, the maintainer refills otherwise
+			available_.notify_one();
+			wake_.notify_one();
+			return;
+		}
+		Idle i = { conn, pool_clock::now() };
+		idle_.push_back(i);
+		lk.unlock();
+		available_.notify_one();
+	}
+
+	RconnectionPool::Lease RconnectionPool::checkout(int *status, int timeout_ms)
+	{
+		if (timeout_ms < 0) timeout_ms = opt_.checkout_timeout_ms;
+		const pool_clock::time_point start = pool_clock::now();
+		const pool_clock::time_point deadline = start + std::chrono::milliseconds(timeout_ms < 0 ? 0 : timeout_ms);
+		std::shared_ptr<Rconnection> conn;
+		int res = 0;
+
+		std::unique_lock<std::mutex> lk(mtx_);
+		for (;;)
+		{
+			if (stopping_)
+			{
+				res = CERR_not_connected;
+				break;
+			}
+			if (!idle_.empty())
+			{
+				conn = idle_.back().conn;
+				idle_.pop_back();
+				break;
+			}
+			if (open_ < opt_.size)
+			{
+				++open_;
+				lk.unlock();
+				res = CERR_connect_failed;
+				conn = open(&res);
+				lk.lock();
+				if (conn)
+				{
+					res = 0;
+					++stats_.created;
+				}
+				else
+				{
+					--open_;
+					++stats_.failures;
+					available_.notify_one();
+				}
+				break;
+			}
+
+			++waiting_;
+			auto ready = [this]() { return stopping_ || !idle_.empty() || open_ < opt_.size; };
+			bool ok = true;
+			if (timeout_ms < 0)
+				available_.wait(lk, ready);
+			else
+				ok = available_.wait_until(lk, deadline, ready);
+			--waiting_;
+			if (!ok)
+			{
+				res = CERR_pool_exhausted;
+				++stats_.timeouts;
+				break;
+			}
+		}
+
+		if (status) *status = res;
+		if (!conn) return Lease();
+
+		if (stopping_)
+		{
+			--open_;
+			lk.unlock();
+			if (status) *status = CERR_not_connected;
+			return Lease();
+		}
+
+		++in_use_;
+		++stats_.checkouts;
+		uint64_t waited = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(pool_clock::now() - start).count();
+		stats_.checkout_wait_total_us += waited;
+		if (waited > stats_.checkout_wait_max_us)
+			stats_.checkout_wait_max_us = waited;
+		lk.unlock();
+		return Lease(shared_from_this(), conn);
+	}
+
+	RpoolStats RconnectionPool::stats() const
+	{
+		std::lock_guard<std::mutex> lk(mtx_);
+		RpoolStats s = stats_;
+		s.size = open_;
+		s.idle = idle_.size();
+		s.in_use = in_use_;
+		s.waiting = waiting_;
+		return s;
+	}
+
+} // namespace Rconnection2
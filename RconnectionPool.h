@@ -0,0 +1,216 @@
+/*
+ *  C++ Interface to Rserve - connection pool
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+/* RconnectionPool keeps up to N connected (and logged in) Rconnections to
+   one endpoint. checkout() hands out an idle connection, opens a new one if
+   the pool is not full yet, or waits for a connection to come back. Leases
+   return the connection on destruction; connections that were disconnected
+   by an I/O error or explicitly discarded are evicted instead. A background
+   thread validates connections that have been idle for a while, evicts the
+   broken ones and tops the pool up again.
+*/
+#pragma once
+
+#ifndef __RCONNECTIONPOOL_H__
+#define __RCONNECTIONPOOL_H__
+
+#include "Rconnection2.h"
+
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable:4251)
+#endif
+
+namespace Rconnection2 {
+
+	struct RCONNECTION2_API RpoolOptions
+	{
+		/** opens a new ready-to-use connection; the default one connects to
+			host:port and logs in if user is set. returns NULL and sets *status
+			on failure. shutdown() waits for a refill in progress, so a custom
+			factory should limit its own connect and login */
+		typedef std::function<std::shared_ptr<Rconnection>(int *status)> Factory;
+		/** returns 0 if the idle connection is still usable. the default one
+			issues queryCustomStatus() and checks that the socket survived. it
+			runs with validate_timeout_ms set as the call timeout */
+		typedef std::function<int(Rconnection& conn)> Validator;
+
+		std::string host;
+		int port;
+		std::string user;
+		std::string pwd;
+
+		size_t size;              // connections kept open (and the upper limit)
+		int checkout_timeout_ms;  // default wait in checkout(), -1 = forever
+		int validate_idle_ms;     // validate connections idle at least this long, 0 = never
+		int validate_timeout_ms;  // limit of the maintenance thread's probes and connects, -1 = none
+		int connect_timeout_ms;   // Rconnection::setConnectTimeout() of new connections
+		int call_timeout_ms;      // Rconnection::setTimeout() of new connections
+		Factory factory;
+		Validator validator;
+
+		RpoolOptions(const char *host_ = "127.0.0.1", int port_ = default_Rsrv_port, size_t size_ = 4)
+			:
+			host(host_),
+			port(port_),
+			user(),
+			pwd(),
+			size(size_),
+			checkout_timeout_ms(-1),
+			validate_idle_ms(30000),
+			validate_timeout_ms(5000),
+			connect_timeout_ms(-1),
+			call_timeout_ms(-1),
+			factory(),
+			validator()
+		{
+		}
+	};
+
+	struct RCONNECTION2_API RpoolStats
+	{
+		size_t size;            // connections currently open
+		size_t idle;
+		size_t in_use;
+		size_t waiting;         // threads blocked in checkout()
+
+		uint64_t checkouts;     // successful ones
+		uint64_t timeouts;
+		uint64_t failures;      // a new connection could not be opened
+		uint64_t created;
+		uint64_t evicted;
+
+		uint64_t checkout_wait_total_us;
+		uint64_t checkout_wait_max_us;
+
+		double checkout_wait_avg_us() const
+		{
+			return checkouts ? (double)checkout_wait_total_us / checkouts : 0.0;
+		}
+	};
+
+	class RCONNECTION2_API RconnectionPool : public std::enable_shared_from_this < RconnectionPool >
+	{
+	private:
+		explicit RconnectionPool(const RconnectionPool&);
+		RconnectionPool& operator=(const RconnectionPool&);
+
+	public:
+		/** a checked out connection, returned to the pool when destroyed */
+		class RCONNECTION2_API Lease
+		{
+		protected:
+			std::shared_ptr<RconnectionPool> pool_;
+			std::shared_ptr<Rconnection> conn_;
+			bool broken_;
+
+			friend class RconnectionPool;
+			Lease(const std::shared_ptr<RconnectionPool>& pool, const std::shared_ptr<Rconnection>& conn)
+				: pool_(pool), conn_(conn), broken_(false) {}
+
+		public:
+			Lease() : pool_(), conn_(), broken_(false) {}
+			Lease(Lease&& other) : pool_(std::move(other.pool_)), conn_(std::move(other.conn_)), broken_(other.broken_) {}
+			Lease& operator=(Lease&& other)
+			{
+				if (this != &other)
+				{
+					release();
+					pool_ = std::move(other.pool_);
+					conn_ = std::move(other.conn_);
+					broken_ = other.broken_;
+				}
+				return *this;
+			}
+			~Lease() { release(); }
+
+			explicit operator bool() const { return (bool)conn_; }
+			Rconnection* operator->() const { return conn_.get(); }
+			Rconnection& operator*() const { return *conn_; }
+			const std::shared_ptr<Rconnection>& get() const { return conn_; }
+
+			/** marks the connection unusable, it is closed instead of returned */
+			void discard() { broken_ = true; }
+
+			/** returns the connection to the pool now */
+			void release();
+
+		private:
+			Lease(const Lease&);
+			Lease& operator=(const Lease&);
+		};
+
+	protected:
+		struct Idle
+		{
+			std::shared_ptr<Rconnection> conn;
+			std::chrono::steady_clock::time_point since;
+		};
+
+		RpoolOptions opt_;
+		mutable std::mutex mtx_;
+		std::condition_variable available_;
+		std::condition_variable wake_;
+		std::vector<Idle> idle_;  // used as a stack - the most recently used is the warmest
+		size_t open_;             // idle + in use + being opened
+		size_t in_use_;
+		size_t waiting_;
+		bool stopping_;
+		RpoolStats stats_;
+		std::thread maintainer_;
+
+		explicit RconnectionPool(const RpoolOptions& opt);
+
+		std::shared_ptr<Rconnection> open(int *status, int limit_ms = -1);
+		void giveBack(const std::shared_ptr<Rconnection>& conn, bool broken);
+		void maintain();
+		void refill();
+
+	public:
+		/** opens the initial connections and starts the maintenance thread */
+		static std::shared_ptr<RconnectionPool> create(const RpoolOptions& opt);
+
+		~RconnectionPool();
+
+		/** waits up to timeout_ms (-1 = options default) for a connection.
+			on failure the lease is empty and *status is CERR_pool_exhausted or
+			the error of opening a new connection */
+		Lease checkout(int *status = 0, int timeout_ms = -1);
+
+		RpoolStats stats() const;
+
+		/** closes all idle connections and stops the maintenance thread;
+			leased connections are closed when they come back */
+		void shutdown();
+	};
+
+} // namespace Rconnection2
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#endif
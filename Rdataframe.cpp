@@ -0,0 +1,175 @@
+/*
+ *  C++ Interface to Rserve - columnar access to data frames
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+#include "Rdataframe.h"
+
+#include <climits>
+
+namespace Rconnection2 {
+
+	static bool hasClass(const Rexp& exp, const char *cls)
+	{
+		std::shared_ptr<Rexp> c = exp.attribute("class");
+		if (!c) return false;
+		if (c->get_type() == XT_ARRAY_STR)
+			return static_cast<Rstrings*>(c.get())->indexOfString(cls) >= 0;
+		if (c->get_type() == XT_STR)
+			return !strcmp(static_cast<Rstring*>(c.get())->c_str(), cls);
+		return false;
+	}
+
+	Rspan<unsigned char> Rdataframe::logicalData(const Rexp& exp)
+	{
+		if (exp.get_type() != XT_ARRAY_BOOL) return Rspan<unsigned char>();
+		const Rlogical& l = static_cast<const Rlogical&>(exp);
+		return Rspan<unsigned char>(l.logicalArray(), l.count());
+	}
+
+	static size_t columnLength(Rdataframe::ColumnType type, Rexp& exp)
+	{
+		switch (type)
+		{
+			case Rdataframe::col_logical:
+				return Rdataframe::logicalData(exp).size;
+			case Rdataframe::col_string:
+				return static_cast<Rstrings&>(exp).count();
+			case Rdataframe::col_other:
+				return 0;
+			default:
+				return exp.length(); // number of elements for Rinteger and Rdouble
+		}
+	}
+
+	bool Rdataframe::isDataFrame(const Rexp& exp)
+	{
+		return exp.get_type() == XT_VECTOR && hasClass(exp, "data.frame");
+	}
+
+	Rdataframe::ColumnType Rdataframe::typeOf(const Rexp& exp)
+	{
+		switch (exp.get_type())
+		{
+			case XT_ARRAY_INT:
+			case XT_INT:
+				return hasClass(exp, "factor") ? col_factor : col_int;
+			case XT_ARRAY_DOUBLE:
+			case XT_DOUBLE:
+				return col_double;
+			case XT_ARRAY_STR:
+				return col_string;
+			case XT_ARRAY_BOOL:
+				return col_logical;
+			default:
+				return col_other;
+		}
+	}
+
+	std::shared_ptr<Rdataframe> Rdataframe::create(const std::shared_ptr<Rexp>& exp)
+	{
+		if (!exp || !isDataFrame(*exp))
+			return std::shared_ptr<Rdataframe>();
+		std::shared_ptr<Rvector> v(exp, static_cast<Rvector*>(exp.get()));
+		return std::shared_ptr<Rdataframe>(new Rdataframe(v));
+	}
+
+	Rdataframe::Rdataframe(const std::shared_ptr<Rvector>& frame)
+		:
+		frame_(frame),
+		cols_(),
+		rows_(0)
+	{
+		std::shared_ptr<Rexp> names = frame_->attribute("names");
+		Rstrings *nv = (names && names->get_type() == XT_ARRAY_STR) ? static_cast<Rstrings*>(names.get()) : NULL;
+
+		size_t n = frame_->length();
+		cols_.resize(n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			Column& c = cols_[i];
+			c.exp = frame_->elementAt((int)i);
+			c.name = (nv && i < nv->count()) ? nv->strings()[i] : NULL;
+			c.type = c.exp ? typeOf(*c.exp) : col_other;
+		}
+
+		// row.names is stored compactly as c(NA_integer_, -n) for automatic names
+		std::shared_ptr<Rexp> rn = frame_->attribute("row.names");
+		if (rn && rn->get_type() == XT_ARRAY_INT)
+		{
+			Rinteger *ri = static_cast<Rinteger*>(rn.get());
+			if (ri->length() == 2 && ri->intAt(0) == INT_MIN)
+				rows_ = (size_t)std::abs(ri->intAt(1));
+			else
+				rows_ = ri->length();
+		}
+		else if (rn && rn->get_type() == XT_ARRAY_STR)
+			rows_ = static_cast<Rstrings*>(rn.get())->count();
+		else if (!cols_.empty() && cols_[0].exp)
+			rows_ = columnLength(cols_[0].type, *cols_[0].exp);
+	}
+
+	size_t Rdataframe::columnIndex(const char *name) const
+	{
+		std::shared_ptr<Rexp> names = frame_->attribute("names");
+		if (!names || names->get_type() != XT_ARRAY_STR)
+			return std::string::npos;
+		int i = static_cast<Rstrings*>(names.get())->indexOfString(name);
+		return (i < 0 || (size_t)i >= cols_.size()) ? std::string::npos : (size_t)i;
+	}
+
+	Rspan<int> Rdataframe::intColumn(size_t i) const
+	{
+		const Column& c = cols_.at(i);
+		if (c.type != col_int && c.type != col_factor)
+			return Rspan<int>();
+		return RvectorSpan<int>(*c.exp);
+	}
+
+	Rspan<double> Rdataframe::doubleColumn(size_t i) const
+	{
+		const Column& c = cols_.at(i);
+		return (c.type == col_double) ? RvectorSpan<double>(*c.exp) : Rspan<double>();
+	}
+
+	Rspan<unsigned char> Rdataframe::logicalColumn(size_t i) const
+	{
+		const Column& c = cols_.at(i);
+		return (c.type == col_logical) ? logicalData(*c.exp) : Rspan<unsigned char>();
+	}
+
+	std::shared_ptr<Rstrings> Rdataframe::stringColumn(size_t i) const
+	{
+		const Column& c = cols_.at(i);
+		if (c.type != col_string)
+			return std::shared_ptr<Rstrings>();
+		return std::shared_ptr<Rstrings>(c.exp, static_cast<Rstrings*>(c.exp.get()));
+	}
+
+	std::shared_ptr<Rstrings> Rdataframe::factorLevels(size_t i) const
+	{
+		const Column& c = cols_.at(i);
+		if (c.type != col_factor)
+			return std::shared_ptr<Rstrings>();
+		std::shared_ptr<Rexp> lv = c.exp->attribute("levels");
+		if (!lv || lv->get_type() != XT_ARRAY_STR)
+			return std::shared_ptr<Rstrings>();
+		return std::shared_ptr<Rstrings>(lv, static_cast<Rstrings*>(lv.get()));
+	}
+
+} // namespace Rconnection2
@@ -0,0 +1,104 @@
+/*
+ *  C++ Interface to Rserve - columnar access to data frames
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+/* Rdataframe presents a received data.frame (an Rvector with class
+   "data.frame", including subclasses such as tibbles) column by column.
+   Numeric, logical and factor columns come as spans pointing straight into
+   the message buffer, character columns as the Rstrings holding them, so
+   nothing is done per cell. The frame keeps its columns - and through them
+   the buffer - alive; spans are valid as long as the frame is.
+
+   NA is represented the R way: NA_INTEGER (INT_MIN) in int and factor
+   columns, the NA NaN in double columns, 2 in logical columns and a NULL
+   string in character columns.
+*/
+#pragma once
+
+#ifndef __RDATAFRAME_H__
+#define __RDATAFRAME_H__
+
+#include "RvectorSpan.h"
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable:4251)
+#endif
+
+namespace Rconnection2 {
+
+	class RCONNECTION2_API Rdataframe
+	{
+	public:
+		enum ColumnType { col_other, col_int, col_double, col_string, col_logical, col_factor };
+
+	protected:
+		struct Column
+		{
+			const char *name;
+			ColumnType type;
+			std::shared_ptr<Rexp> exp;
+		};
+
+		std::shared_ptr<Rvector> frame_;
+		std::vector<Column> cols_;
+		size_t rows_;
+
+		explicit Rdataframe(const std::shared_ptr<Rvector>& frame);
+
+	public:
+		/** NULL unless exp is a data.frame */
+		static std::shared_ptr<Rdataframe> create(const std::shared_ptr<Rexp>& exp);
+
+		/** true if exp is a vector whose class attribute includes "data.frame" */
+		static bool isDataFrame(const Rexp& exp);
+		/** how exp would be presented as a column */
+		static ColumnType typeOf(const Rexp& exp);
+		/** the values of an XT_ARRAY_BOOL, empty for other types */
+		static Rspan<unsigned char> logicalData(const Rexp& exp);
+
+		size_t rows() const { return rows_; }
+		size_t columns() const { return cols_.size(); }
+		const std::shared_ptr<Rvector>& frame() const { return frame_; }
+
+		/** NULL if the columns are not named */
+		const char *columnName(size_t i) const { return cols_.at(i).name; }
+		/** std::string::npos if there is no such column */
+		size_t columnIndex(const char *name) const;
+		ColumnType columnType(size_t i) const { return cols_.at(i).type; }
+		const std::shared_ptr<Rexp>& column(size_t i) const { return cols_.at(i).exp; }
+
+		/* typed columns - empty if the column has another type */
+
+		/** int columns, and the 1-based level codes of factors */
+		Rspan<int> intColumn(size_t i) const;
+		Rspan<double> doubleColumn(size_t i) const;
+		/** 0 = FALSE, 1 = TRUE, 2 = NA */
+		Rspan<unsigned char> logicalColumn(size_t i) const;
+		std::shared_ptr<Rstrings> stringColumn(size_t i) const;
+		std::shared_ptr<Rstrings> factorLevels(size_t i) const;
+	};
+
+} // namespace Rconnection2
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#endif
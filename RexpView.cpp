@@ -0,0 +1,201 @@
+/*
+ *  C++ Interface to Rserve - non-owning views of encoded SEXPs
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+#include "RexpView.h"
+
+namespace Rconnection2 {
+
+	RexpView::RexpView(const unsigned int *pos, const char *end)
+		:
+		pos_(NULL),
+		data_(NULL),
+		attr_(NULL),
+		len_(0),
+		type_(-1)
+	{
+		if (!pos || !end || end - (const char*)pos < 4) return;
+		size_t avail = end - (const char*)pos;
+		int hl = 1;
+		unsigned int p1 = ptoi(pos[0]);
+		Rsize_t len = p1 >> 8;
+		if ((p1&XT_LARGE) > 0)
+		{
+			if (avail < 8) return;
+			hl++;
+			len |= ((Rsize_t)(ptoi(pos[1]))) << 24;
+		}
+		if (len > avail - hl * 4) return;
+		const char *d = (const char*)(pos + hl);
+		if (p1&XT_HAS_ATTR)
+		{
+			// the attributes come first and must fit into the payload
+			RexpView a((const unsigned int*)d, d + len);
+			if (!a.valid()) return;
+			attr_ = (const unsigned int*)d;
+			len -= a.next() - d;
+			d = a.next();
+		}
+		pos_ = pos;
+		data_ = d;
+		len_ = len;
+		type_ = p1 & 0x3f;
+	}
+
+	RexpView RexpView::fromMessage(const Rmessage& msg)
+	{
+		if (msg.get_par_count() != 1)
+			return RexpView();
+		const unsigned int *d = msg.get_par(0);
+		const char *eod = msg.get_data() + msg.get_len();
+		if (eod - (const char*)d < 4)
+			return RexpView();
+		unsigned int p1 = ptoi(d[0]);
+		if ((p1 & 0x3f) != DT_SEXP)
+			return RexpView();
+		int hl = ((p1&DT_LARGE) > 0) ? 2 : 1;
+		if (eod - (const char*)d < hl * 4)
+			return RexpView();
+		// the parameter length bounds the SEXP, the message end bounds both
+		uint64_t len = p1 >> 8;
+		if (hl == 2) len |= (uint64_t)ptoi(d[1]) << 24;
+		const char *end = (const char*)(d + hl);
+		end = (len < (uint64_t)(eod - end)) ? end + len : eod;
+		return RexpView(d + hl, end);
+	}
+
+	RexpView RexpView::attribute(const char *name) const
+	{
+		return attributes().byTag(name);
+	}
+
+	bool RexpView::hasChildren() const
+	{
+		switch (type_)
+		{
+			case XT_VECTOR:
+			case XT_VECTOR_EXP:
+			case XT_LIST_NOTAG:
+			case XT_LIST_TAG:
+			case XT_LANG_NOTAG:
+			case XT_LANG_TAG:
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	Rsize_t RexpView::length() const
+	{
+		switch (type_)
+		{
+			case XT_INT:
+			case XT_ARRAY_INT:
+				return len_ / 4;
+
+			case XT_DOUBLE:
+			case XT_ARRAY_DOUBLE:
+				return len_ / 8;
+
+			case XT_ARRAY_CPLX:
+				return len_ / 16;
+
+			case XT_ARRAY_BOOL:
+			case XT_RAW:
+			{
+				if (len_ < 4) return 0;
+				Rsize_t n = ptoi(*(const unsigned int*)data_);
+				return (n > len_ - 4) ? 0 : n;
+			}
+
+			case XT_ARRAY_STR:
+			{
+				Rsize_t n = 0;
+				const char *c = data_, *eod = data_ + len_;
+				while (c < eod)
+				{
+					const char *z = (const char*)memchr(c, 0, eod - c);
+					if (!z) break; // padding
+					++n;
+					c = z + 1;
+				}
+				return n;
+			}
+
+			default:
+			{
+				Rsize_t n = 0;
+				for (iterator it = begin(), e = end(); it != e; ++it)
+					++n;
+				return n;
+			}
+		}
+	}
+
+	const char *RexpView::stringValue() const
+	{
+		// only strings terminated inside the payload
+		if (type_ == XT_STR || type_ == XT_SYMNAME)
+			return memchr(data_, 0, len_) ? data_ : NULL;
+		// the name of a symbol is a string SEXP, see Rsymbol::fix_content()
+		if (type_ == XT_SYM && len_ >= 4 && *data_ == XT_STR)
+			return memchr(data_ + 4, 0, len_ - 4) ? data_ + 4 : NULL;
+		return NULL;
+	}
+
+	const char *RexpView::stringAt(Rsize_t i) const
+	{
+		if (type_ != XT_ARRAY_STR) return NULL;
+		const char *c = data_, *eod = data_ + len_;
+		while (c < eod)
+		{
+			const char *z = (const char*)memchr(c, 0, eod - c);
+			if (!z) break;
+			if (!i--)
+			{
+				// a lone 0xFF is NA, otherwise it escapes a leading 0xFF
+				if (*c == (char)0xFF)
+					return (z == c + 1) ? NULL : c + 1;
+				return c;
+			}
+			c = z + 1;
+		}
+		return NULL;
+	}
+
+	RexpView RexpView::childAt(Rsize_t i) const
+	{
+		for (iterator it = begin(), e = end(); it != e; ++it)
+			if (!i--) return *it;
+		return RexpView();
+	}
+
+	RexpView RexpView::byTag(const char *name) const
+	{
+		if (!isTagged()) return RexpView();
+		for (iterator it = begin(), e = end(); it != e; ++it)
+		{
+			const char *t = it.tag().stringValue();
+			if (t && !strcmp(t, name))
+				return *it;
+		}
+		return RexpView();
+	}
+
+} // namespace Rconnection2
@@ -0,0 +1,195 @@
+/*
+ *  C++ Interface to Rserve - non-owning views of encoded SEXPs
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+/* RexpView reads a SEXP right where it is encoded in a received message,
+   without creating Rexp objects. A view is just a position plus the decoded
+   header (same rules as Rexp::parseBytes), so it is cheap to copy and never
+   allocates; children are reached by walking the encoding in place. Views do
+   not own anything - the message must outlive them - and never modify the
+   buffer, so any number of threads may read through them at once.
+
+   Every view carries the end of the bytes it may cover. A SEXP whose header
+   or length runs past it, or a child running past its parent, gives an
+   invalid view, and iteration stops there - a malformed or truncated message
+   is never read beyond its end.
+
+   Typed data pointers (intData(), doubleData()) point at the wire encoding,
+   which is little endian. With SWAPEND use intAt()/doubleAt() instead, and
+   do not decode the same message into Rexp objects at the same time, since
+   their fix_content() swaps the data in place.
+*/
+#pragma once
+
+#ifndef __REXPVIEW_H__
+#define __REXPVIEW_H__
+
+#include "Rconnection2.h"
+
+#include <iterator>
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable:4251)
+#endif
+
+namespace Rconnection2 {
+
+	class RCONNECTION2_API RexpView
+	{
+	public:
+		class iterator;
+
+		RexpView() : pos_(NULL), data_(NULL), attr_(NULL), len_(0), type_(-1) {}
+		/** the SEXP encoded at pos, invalid unless it ends at or before end */
+		RexpView(const unsigned int *pos, const char *end);
+
+		/** the SEXP of an eval response, invalid if the message carries none */
+		static RexpView fromMessage(const Rmessage& msg);
+
+		bool valid() const { return pos_ != NULL; }
+		int type() const { return type_; }
+		const unsigned int *position() const { return pos_; }
+
+		/** payload without header and attributes */
+		const char *data() const { return data_; }
+		Rsize_t byteLength() const { return len_; }
+		/** first byte after the SEXP */
+		const char *next() const { return data_ + len_; }
+
+		bool hasAttributes() const { return attr_ != NULL; }
+		RexpView attributes() const { return attr_ ? RexpView(attr_, (const char*)data_) : RexpView(); }
+		/** entry of the attribute pairlist tagged name, invalid if missing */
+		RexpView attribute(const char *name) const;
+
+		/** number of elements: values of int/double/logical/raw/complex arrays, strings of
+			XT_ARRAY_STR, children of vectors and lists. O(n) for the latter two */
+		Rsize_t length() const;
+
+		/* --- scalars and arrays --- */
+
+		const int *intData() const { return (type_ == XT_ARRAY_INT || type_ == XT_INT) ? (const int*)data_ : NULL; }
+		const double *doubleData() const { return (type_ == XT_ARRAY_DOUBLE || type_ == XT_DOUBLE) ? (const double*)data_ : NULL; }
+		/** the bytes of XT_ARRAY_BOOL and XT_RAW behind their count, length() of them */
+		const unsigned char *byteData() const { return (type_ == XT_ARRAY_BOOL || type_ == XT_RAW) ? (const unsigned char*)data_ + 4 : NULL; }
+		/** unchecked, in host byte order */
+		int intAt(Rsize_t i) const { return (int)ptoi(((const unsigned int*)data_)[i]); }
+		double doubleAt(Rsize_t i) const { return ptod(((const double*)data_)[i]); }
+
+		/** XT_STR, XT_SYMNAME and XT_SYM, NULL for other types */
+		const char *stringValue() const;
+		/** i-th string of XT_ARRAY_STR, NULL if NA or out of range. O(i) */
+		const char *stringAt(Rsize_t i) const;
+
+		/* --- vectors and lists --- */
+
+		/** iterates the values of XT_VECTOR and XT_LIST_(NO)TAG/XT_LANG_(NO)TAG;
+			empty for other types */
+		iterator begin() const;
+		iterator end() const;
+		/** O(i), invalid if out of range */
+		RexpView childAt(Rsize_t i) const;
+		/** value tagged name in a tagged list, invalid if missing */
+		RexpView byTag(const char *name) const;
+
+	private:
+		const unsigned int *pos_;
+		const char *data_;
+		const unsigned int *attr_;
+		Rsize_t len_;
+		int type_;
+
+		bool hasChildren() const;
+		bool isTagged() const { return type_ == XT_LIST_TAG || type_ == XT_LANG_TAG; }
+	};
+
+	/** forward iterator over the children of a vector or list. for tagged
+		lists tag() is the tag of the current value */
+	class RCONNECTION2_API RexpView::iterator
+	{
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef RexpView value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const RexpView* pointer;
+		typedef const RexpView& reference;
+
+		iterator() : cur_(), end_(NULL), tagged_(false) {}
+		iterator(const char *pos, const char *end, bool tagged)
+			:
+			cur_(RexpView((const unsigned int*)pos, end)),
+			end_(end),
+			tagged_(tagged)
+		{
+		}
+
+		reference operator*() const { return cur_; }
+		pointer operator->() const { return &cur_; }
+
+		RexpView tag() const
+		{
+			return (tagged_ && cur_.valid()) ? RexpView((const unsigned int*)cur_.next(), end_) : RexpView();
+		}
+
+		iterator& operator++()
+		{
+			if (!cur_.valid()) return *this;
+			const char *p = cur_.next();
+			if (tagged_)
+			{
+				RexpView t((const unsigned int*)p, end_);
+				p = t.valid() ? t.next() : end_;
+			}
+			cur_ = RexpView((const unsigned int*)p, end_);
+			return *this;
+		}
+
+		iterator operator++(int)
+		{
+			iterator it(*this);
+			++*this;
+			return it;
+		}
+
+		bool operator==(const iterator& other) const { return cur_.position() == other.cur_.position(); }
+		bool operator!=(const iterator& other) const { return !(*this == other); }
+
+	private:
+		RexpView cur_;
+		const char *end_;
+		bool tagged_;
+	};
+
+	inline RexpView::iterator RexpView::begin() const
+	{
+		return hasChildren() ? iterator(data_, data_ + len_, isTagged()) : iterator();
+	}
+
+	inline RexpView::iterator RexpView::end() const
+	{
+		return iterator();
+	}
+
+} // namespace Rconnection2
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#endif
@@ -0,0 +1,219 @@
+/*
+ *  C++ Interface to Rserve - multi-endpoint load balancer
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+#include "RloadBalancer.h"
+
+#include <algorithm>
+
+namespace Rconnection2 {
+
+	typedef std::chrono::steady_clock lb_clock;
+
+	// requests report a RESP_ERR reply as -20 - the value of CERR_auth_unsupported,
+	// which only login, i.e. checkout(), can return
+#define LB_R_ERROR -20
+
+	// the status of a call on a leased connection: an R error is a valid answer,
+	// everything else negative means the endpoint let us down
+	static bool isEndpointFailure(int status)
+	{
+		return status < 0 && status != LB_R_ERROR && status != CERR_eval_failed;
+	}
+
+	RloadBalancer::RloadBalancer(const RbalancerOptions& opt)
+		:
+		opt_(opt),
+		mtx_(),
+		nodes_()
+	{
+		nodes_.resize(opt_.endpoints.size());
+		for (size_t i = 0; i < nodes_.size(); ++i)
+		{
+			Node& n = nodes_[i];
+			n.endpoint = opt_.endpoints[i];
+			RpoolOptions po = opt_.pool;
+			po.host = n.endpoint.host;
+			po.port = n.endpoint.port;
+			n.pool = RconnectionPool::create(po);
+			n.health = h_healthy;
+			n.outstanding = 0;
+			n.ewma_ms = 0.0;
+			n.samples = 0;
+			n.failures_in_row = 0;
+			n.eject_ms = opt_.eject_ms;
+			n.requests = 0;
+			n.failures = 0;
+			n.ejections = 0;
+			n.saturated = 0;
+		}
+	}
+
+	size_t RloadBalancer::pick()
+	{
+		std::lock_guard<std::mutex> lk(mtx_);
+		lb_clock::time_point now = lb_clock::now();
+		size_t best = nodes_.size();
+		size_t fallback = nodes_.size();
+		for (size_t i = 0; i < nodes_.size(); ++i)
+		{
+			Node& n = nodes_[i];
+			if (n.health == h_ejected && n.ejected_until <= now)
+				n.health = h_probing;
+			// a probing endpoint gets exactly one request until it has proven itself
+			bool usable = (n.health == h_healthy) || (n.health == h_probing && n.outstanding == 0);
+			if (!usable)
+			{
+				if (n.health == h_ejected && (fallback == nodes_.size() || n.ejected_until < nodes_[fallback].ejected_until))
+					fallback = i;
+				continue;
+			}
+			if (best == nodes_.size() || n.outstanding < nodes_[best].outstanding ||
+				(n.outstanding == nodes_[best].outstanding && n.ewma_ms < nodes_[best].ewma_ms))
+				best = i;
+		}
+		// everything is ejected - rather try the one coming back first than fail
+		if (best == nodes_.size()) best = fallback;
+		if (best == nodes_.size()) return best;
+		++nodes_[best].outstanding;
+		++nodes_[best].requests;
+		return best;
+	}
+
+	void RloadBalancer::eject(Node& n, lb_clock::time_point now)
+	{
+		n.health = h_ejected;
+		n.ejected_until = now + std::chrono::milliseconds(n.eject_ms);
+		n.eject_ms = std::min(n.eject_ms * 2, opt_.eject_max_ms);
+		n.failures_in_row = 0;
+		++n.ejections;
+	}
+
+	void RloadBalancer::finish(size_t i, bool leased, int status, double latency_ms)
+	{
+		std::lock_guard<std::mutex> lk(mtx_);
+		lb_clock::time_point now = lb_clock::now();
+		Node& n = nodes_[i];
+		--n.outstanding;
+
+		// all pooled connections were busy - our own load, the endpoint never saw the request
+		if (!leased && status == CERR_pool_exhausted)
+		{
+			++n.saturated;
+			return;
+		}
+
+		// any other failed checkout could not connect or log in
+		if (!leased || isEndpointFailure(status))
+		{
+			++n.failures;
+			++n.failures_in_row;
+			if (n.health == h_probing || (n.health == h_healthy && n.failures_in_row >= opt_.max_failures))
+				eject(n, now);
+			return;
+		}
+
+		n.failures_in_row = 0;
+		if (n.health == h_probing)
+		{
+			// back in business, forget the latency it had when it was ejected
+			n.health = h_healthy;
+			n.eject_ms = opt_.eject_ms;
+			n.samples = 0;
+		}
+		n.ewma_ms = n.samples ? opt_.ewma_alpha * latency_ms + (1.0 - opt_.ewma_alpha) * n.ewma_ms : latency_ms;
+		++n.samples;
+
+		if (opt_.slow_factor <= 0.0 || n.health != h_healthy || n.samples < opt_.slow_min_samples)
+			return;
+		// compare against the fastest other healthy endpoint; never eject the last one
+		const Node *fastest = NULL;
+		for (const auto& o : nodes_)
+			if (&o != &n && o.health == h_healthy && o.samples >= opt_.slow_min_samples &&
+				(!fastest || o.ewma_ms < fastest->ewma_ms))
+				fastest = &o;
+		if (fastest && n.ewma_ms > opt_.slow_factor * fastest->ewma_ms)
+			eject(n, now);
+	}
+
+	template<class F> int RloadBalancer::run(int *status, const F& call)
+	{
+		size_t i = pick();
+		if (i == nodes_.size())
+		{
+			if (status) *status = CERR_not_connected;
+			return CERR_not_connected;
+		}
+		lb_clock::time_point start = lb_clock::now();
+		int res = 0;
+		bool leased = false;
+		{
+			RconnectionPool::Lease conn = nodes_[i].pool->checkout(&res);
+			if (conn)
+			{
+				leased = true;
+				call(*conn, &res);
+			}
+		}
+		double ms = std::chrono::duration<double, std::milli>(lb_clock::now() - start).count();
+		finish(i, leased, res, ms);
+		if (status) *status = res;
+		return res;
+	}
+
+	std::shared_ptr<Rexp> RloadBalancer::eval_to_Rexp(const char *cmd, int *status)
+	{
+		std::shared_ptr<Rexp> exp;
+		run(status, [&](Rconnection& conn, int *res)
+		{
+			exp = conn.eval_to_Rexp(cmd, res, 0);
+		});
+		return exp;
+	}
+
+	int RloadBalancer::voidEval(const char *cmd)
+	{
+		return run(0, [&](Rconnection& conn, int *res)
+		{
+			*res = conn.voidEval(cmd);
+		});
+	}
+
+	std::vector<RendpointStats> RloadBalancer::stats() const
+	{
+		std::vector<RendpointStats> out;
+		std::lock_guard<std::mutex> lk(mtx_);
+		out.resize(nodes_.size());
+		for (size_t i = 0; i < nodes_.size(); ++i)
+		{
+			const Node& n = nodes_[i];
+			out[i].endpoint = n.endpoint;
+			out[i].healthy = (n.health == h_healthy);
+			out[i].outstanding = n.outstanding;
+			out[i].latency_ewma_ms = n.ewma_ms;
+			out[i].requests = n.requests;
+			out[i].failures = n.failures;
+			out[i].ejections = n.ejections;
+			out[i].saturated = n.saturated;
+			out[i].pool = n.pool->stats();
+		}
+		return out;
+	}
+
+} // namespace Rconnection2
@@ -0,0 +1,159 @@
+/*
+ *  C++ Interface to Rserve - multi-endpoint load balancer
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+/* RloadBalancer spreads requests over several Rserve endpoints, each served
+   by its own RconnectionPool. Every request goes to the healthy endpoint with
+   the fewest outstanding requests, ties are broken by the lower EWMA latency.
+   Endpoints that fail repeatedly, or whose latency runs far above the best
+   healthy one, are ejected for a back-off period and then re-admitted after
+   a single successful probe request.
+*/
+#pragma once
+
+#ifndef __RLOADBALANCER_H__
+#define __RLOADBALANCER_H__
+
+#include "RconnectionPool.h"
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable:4251)
+#endif
+
+namespace Rconnection2 {
+
+	struct RCONNECTION2_API Rendpoint
+	{
+		std::string host;
+		int port;
+
+		Rendpoint(const char *host_ = "127.0.0.1", int port_ = default_Rsrv_port) : host(host_), port(port_) {}
+	};
+
+	struct RCONNECTION2_API RbalancerOptions
+	{
+		std::vector<Rendpoint> endpoints;
+		/** template for the pool of each endpoint - host and port are
+			replaced, everything else (size, login, timeouts ...) is used as is */
+		RpoolOptions pool;
+
+		double ewma_alpha;          // weight of a new latency sample
+		int max_failures;           // consecutive failures before an endpoint is ejected
+		double slow_factor;         // eject if the EWMA exceeds slow_factor * the best healthy one, 0 = never
+		unsigned int slow_min_samples; // samples an endpoint needs before it can be ejected as slow
+		int eject_ms;               // first ejection period, doubled on every repeated ejection
+		int eject_max_ms;
+
+		RbalancerOptions()
+			:
+			endpoints(),
+			pool(),
+			ewma_alpha(0.2),
+			max_failures(3),
+			slow_factor(4.0),
+			slow_min_samples(20),
+			eject_ms(1000),
+			eject_max_ms(60000)
+		{
+		}
+	};
+
+	struct RCONNECTION2_API RendpointStats
+	{
+		Rendpoint endpoint;
+		bool healthy;           // false while ejected or waiting for its probe
+		size_t outstanding;
+		double latency_ewma_ms;
+		uint64_t requests;
+		uint64_t failures;
+		uint64_t ejections;
+		uint64_t saturated;     // requests that found the pool full (not failures)
+		RpoolStats pool;
+	};
+
+	class RCONNECTION2_API RloadBalancer
+	{
+	private:
+		explicit RloadBalancer(const RloadBalancer&);
+		RloadBalancer& operator=(const RloadBalancer&);
+
+	protected:
+		enum Health { h_healthy, h_ejected, h_probing };
+
+		struct Node
+		{
+			Rendpoint endpoint;
+			std::shared_ptr<RconnectionPool> pool;
+			Health health;
+			size_t outstanding;
+			double ewma_ms;
+			uint64_t samples;       // since the last re-admission
+			int failures_in_row;
+			int eject_ms;           // current back-off
+			std::chrono::steady_clock::time_point ejected_until;
+			uint64_t requests;
+			uint64_t failures;
+			uint64_t ejections;
+			uint64_t saturated;
+		};
+
+		RbalancerOptions opt_;
+		mutable std::mutex mtx_;
+		std::vector<Node> nodes_;
+
+		explicit RloadBalancer(const RbalancerOptions& opt);
+
+		size_t pick();
+		void finish(size_t i, bool leased, int status, double latency_ms);
+		void eject(Node& n, std::chrono::steady_clock::time_point now);
+
+		template<class F> int run(int *status, const F& call);
+
+	public:
+		/** creates the pools of all endpoints */
+		static std::shared_ptr<RloadBalancer> create(const RbalancerOptions& opt)
+		{
+			return std::shared_ptr<RloadBalancer>(new RloadBalancer(opt));
+		}
+
+		~RloadBalancer() {}
+
+		/* --- requests, routed to the least loaded healthy endpoint. the status
+		       values are the ones of Rconnection, plus CERR_not_connected if
+		       there are no endpoints at all --- */
+
+		std::shared_ptr<Rexp> eval_to_Rexp(const char *cmd, int *status = 0);
+		template<class V> std::shared_ptr<V> eval(const char *cmd, int *status = 0)
+		{
+			std::shared_ptr<Rexp> p = eval_to_Rexp(cmd, status);
+			return std::shared_ptr<V>(p, static_cast<V*>(p.get()));
+		}
+		int voidEval(const char *cmd);
+
+		std::vector<RendpointStats> stats() const;
+	};
+
+} // namespace Rconnection2
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#endif
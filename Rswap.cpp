@@ -0,0 +1,234 @@
+/*
+ *  C++ Interface to Rserve - bulk byte order conversion
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+#include "Rswap.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define RSWAP_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define RSWAP_TARGET(X)
+#else
+#define RSWAP_TARGET(X) __attribute__((target(X)))
+#endif
+#endif
+
+namespace Rconnection2 {
+
+	typedef void (*swap_fn)(void *data, size_t n);
+
+	static inline uint32_t bswap32(uint32_t x)
+	{
+#if defined(__GNUC__)
+		return __builtin_bswap32(x);
+#else
+		return (x >> 24) | ((x >> 8) & 0xff00) | ((x << 8) & 0xff0000) | (x << 24);
+#endif
+	}
+
+	static inline uint64_t bswap64(uint64_t x)
+	{
+#if defined(__GNUC__)
+		return __builtin_bswap64(x);
+#else
+		return ((uint64_t)bswap32((uint32_t)x) << 32) | bswap32((uint32_t)(x >> 32));
+#endif
+	}
+
+	static void swap32_scalar(void *data, size_t n)
+	{
+		char *p = (char*)data;
+		for (size_t i = 0; i < n; ++i, p += 4)
+		{
+			uint32_t x;
+			memcpy(&x, p, 4);
+			x = bswap32(x);
+			memcpy(p, &x, 4);
+		}
+	}
+
+	static void swap64_scalar(void *data, size_t n)
+	{
+		char *p = (char*)data;
+		for (size_t i = 0; i < n; ++i, p += 8)
+		{
+			uint64_t x;
+			memcpy(&x, p, 8);
+			x = bswap64(x);
+			memcpy(p, &x, 8);
+		}
+	}
+
+#ifdef RSWAP_X86
+
+	RSWAP_TARGET("ssse3")
+	static void swap32_ssse3(void *data, size_t n)
+	{
+		const __m128i m = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+		char *p = (char*)data;
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4, p += 16)
+			_mm_storeu_si128((__m128i*)p, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), m));
+		swap32_scalar(p, n - i);
+	}
+
+	RSWAP_TARGET("ssse3")
+	static void swap64_ssse3(void *data, size_t n)
+	{
+		const __m128i m = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+		char *p = (char*)data;
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2, p += 16)
+			_mm_storeu_si128((__m128i*)p, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), m));
+		swap64_scalar(p, n - i);
+	}
+
+	// vpshufb works within 128-bit lanes, so the mask is the same in both
+	RSWAP_TARGET("avx2")
+	static void swap32_avx2(void *data, size_t n)
+	{
+		const __m256i m = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+			3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+		char *p = (char*)data;
+		size_t i = 0;
+		for (; i + 16 <= n; i += 16, p += 64)
+		{
+			__m256i a = _mm256_loadu_si256((const __m256i*)p);
+			__m256i b = _mm256_loadu_si256((const __m256i*)(p + 32));
+			_mm256_storeu_si256((__m256i*)p, _mm256_shuffle_epi8(a, m));
+			_mm256_storeu_si256((__m256i*)(p + 32), _mm256_shuffle_epi8(b, m));
+		}
+		for (; i + 8 <= n; i += 8, p += 32)
+			_mm256_storeu_si256((__m256i*)p, _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)p), m));
+		swap32_scalar(p, n - i);
+	}
+
+	RSWAP_TARGET("avx2")
+	static void swap64_avx2(void *data, size_t n)
+	{
+		const __m256i m = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+			7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+		char *p = (char*)data;
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8, p += 64)
+		{
+			__m256i a = _mm256_loadu_si256((const __m256i*)p);
+			__m256i b = _mm256_loadu_si256((const __m256i*)(p + 32));
+			_mm256_storeu_si256((__m256i*)p, _mm256_shuffle_epi8(a, m));
+			_mm256_storeu_si256((__m256i*)(p + 32), _mm256_shuffle_epi8(b, m));
+		}
+		for (; i + 4 <= n; i += 4, p += 32)
+			_mm256_storeu_si256((__m256i*)p, _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)p), m));
+		swap64_scalar(p, n - i);
+	}
+
+	static bool cpuHas(const char *feature)
+	{
+#ifdef _MSC_VER
+		int r[4];
+		__cpuid(r, 1);
+		if (!strcmp(feature, "ssse3"))
+			return (r[2] & (1 << 9)) != 0;
+		// AVX2 also needs the OS to save the YMM registers
+		if (!(r[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+			return false;
+		__cpuidex(r, 7, 0);
+		return (r[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		if (!strcmp(feature, "ssse3"))
+			return __builtin_cpu_supports("ssse3");
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+#endif
+
+	struct SwapKernel
+	{
+		const char *name;
+		swap_fn swap32;
+		swap_fn swap64;
+	};
+
+	static const SwapKernel swap_kernels[] = {
+#ifdef RSWAP_X86
+		{ "avx2", swap32_avx2, swap64_avx2 },
+		{ "ssse3", swap32_ssse3, swap64_ssse3 },
+#endif
+		{ "scalar", swap32_scalar, swap64_scalar }
+	};
+
+	static bool kernelSupported(const SwapKernel& k)
+	{
+#ifdef RSWAP_X86
+		if (k.swap32 != swap32_scalar)
+			return cpuHas(k.name);
+#else
+		(void)k;
+#endif
+		return true;
+	}
+
+	static const SwapKernel *bestKernel()
+	{
+		for (const SwapKernel& k : swap_kernels)
+			if (kernelSupported(k))
+				return &k;
+		return NULL; // not reached, scalar is always there
+	}
+
+	// chosen on first use (thread-safe static initialization)
+	static const SwapKernel *&currentKernel()
+	{
+		static const SwapKernel *k = bestKernel();
+		return k;
+	}
+
+	void swapBytes32(void *data, size_t n)
+	{
+		currentKernel()->swap32(data, n);
+	}
+
+	void swapBytes64(void *data, size_t n)
+	{
+		currentKernel()->swap64(data, n);
+	}
+
+	const char *swapKernel()
+	{
+		return currentKernel()->name;
+	}
+
+	bool selectSwapKernel(const char *name)
+	{
+		for (const SwapKernel& k : swap_kernels)
+			if (!strcmp(k.name, name))
+			{
+				if (!kernelSupported(k))
+					return false;
+				currentKernel() = &k;
+				return true;
+			}
+		return false;
+	}
+
+} // namespace Rconnection2
@@ -0,0 +1,55 @@
+/*
+ *  C++ Interface to Rserve - bulk byte order conversion
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+/* Byte swapping of whole int/double arrays, used under SWAPEND wherever
+   arrays are converted between host and QAP1 (little endian) order. On x86
+   the kernel is picked at run time - AVX2, SSSE3 or a scalar loop - and
+   another one can be selected to compare or verify them. The data does not
+   need to be aligned.
+
+   x86 hosts are little endian, so the swap path is never taken there in
+   normal builds. "make SWAPEND=1" defines SWAPEND anyway in order to
+   benchmark and verify it; such a build talks byte-swapped QAP1 and cannot
+   be used with a real server.
+*/
+#pragma once
+
+#ifndef __RSWAP_H__
+#define __RSWAP_H__
+
+#include "Rconnection2.h"
+
+namespace Rconnection2 {
+
+	/** reverses the byte order of n 32-bit elements in place */
+	RCONNECTION2_API void swapBytes32(void *data, size_t n);
+	/** reverses the byte order of n 64-bit elements in place */
+	RCONNECTION2_API void swapBytes64(void *data, size_t n);
+
+	/** kernel in use: "avx2", "ssse3" or "scalar" */
+	RCONNECTION2_API const char *swapKernel();
+	/** switches to the named kernel, returns false if the CPU or the
+		compiler does not support it. not thread-safe, meant for tests and
+		benchmarks */
+	RCONNECTION2_API bool selectSwapKernel(const char *name);
+
+} // namespace Rconnection2
+
+#endif
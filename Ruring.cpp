@@ -0,0 +1,228 @@
+/*
+ *  C++ Interface to Rserve - io_uring submission/completion rings
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+#include "Ruring.h"
+
+#if defined(__linux__) && defined(RCONNECTION2_IO_URING)
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <stdint.h>
+
+namespace Rconnection2 {
+
+	static int uring_setup(unsigned int entries, struct io_uring_params *p)
+	{
+		return (int)syscall(__NR_io_uring_setup, entries, p);
+	}
+
+	static int uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags)
+	{
+		return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+	}
+
+	static int uring_register(int fd, unsigned int opcode, const void *arg, unsigned int nr_args)
+	{
+		return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+	}
+
+	Ruring::Ruring()
+		:
+		fd_(-1),
+		features_(0),
+		sq_ptr_(MAP_FAILED),
+		sq_size_(0),
+		cq_ptr_(MAP_FAILED),
+		cq_size_(0),
+		sqes_(NULL),
+		sqes_size_(0),
+		sq_head_(NULL),
+		sq_tail_(NULL),
+		sq_mask_(0),
+		sq_entries_(0),
+		sq_array_(NULL),
+		sqe_tail_(0),
+		cq_head_(NULL),
+		cq_tail_(NULL),
+		cq_mask_(0),
+		cqes_(NULL),
+		ts_(),
+		bufs_(NULL),
+		buf_size_(0),
+		nbufs_(0),
+		free_bufs_()
+	{
+	}
+
+	std::unique_ptr<Ruring> Ruring::create(unsigned int entries, unsigned int nbufs, size_t buf_size)
+	{
+		std::unique_ptr<Ruring> ring(new Ruring());
+		if (ring->setup(entries, nbufs, buf_size))
+			ring.reset();
+		return ring;
+	}
+
+	int Ruring::setup(unsigned int entries, unsigned int nbufs, size_t buf_size)
+	{
+		struct io_uring_params p;
+		memset(&p, 0, sizeof(p));
+		fd_ = uring_setup(entries, &p);
+		if (fd_ < 0) return -1;
+		features_ = p.features;
+		// sockets are non-blocking, without fast poll every recv could fail with EAGAIN
+		if (!(features_ & IORING_FEAT_FAST_POLL)) return -1;
+
+		sq_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+		cq_size_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+		if (features_ & IORING_FEAT_SINGLE_MMAP)
+		{
+			if (cq_size_ > sq_size_) sq_size_ = cq_size_;
+			cq_size_ = 0;
+		}
+		sq_ptr_ = mmap(NULL, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+		if (sq_ptr_ == MAP_FAILED) return -1;
+		if (cq_size_)
+		{
+			cq_ptr_ = mmap(NULL, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+			if (cq_ptr_ == MAP_FAILED) return -1;
+		}
+		char *cq = (char*)(cq_size_ ? cq_ptr_ : sq_ptr_);
+		sqes_size_ = p.sq_entries * sizeof(struct io_uring_sqe);
+		void *sqes = mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+		if (sqes == MAP_FAILED) return -1;
+		sqes_ = (struct io_uring_sqe*)sqes;
+
+		char *sq = (char*)sq_ptr_;
+		sq_head_ = (unsigned int*)(sq + p.sq_off.head);
+		sq_tail_ = (unsigned int*)(sq + p.sq_off.tail);
+		sq_mask_ = *(unsigned int*)(sq + p.sq_off.ring_mask);
+		sq_entries_ = *(unsigned int*)(sq + p.sq_off.ring_entries);
+		sq_array_ = (unsigned int*)(sq + p.sq_off.array);
+		sqe_tail_ = *sq_tail_;
+		cq_head_ = (unsigned int*)(cq + p.cq_off.head);
+		cq_tail_ = (unsigned int*)(cq + p.cq_off.tail);
+		cq_mask_ = *(unsigned int*)(cq + p.cq_off.ring_mask);
+		cqes_ = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+		// registered buffers are optional - RLIMIT_MEMLOCK may not allow them
+		if (nbufs && buf_size)
+		{
+			void *mem = mmap(NULL, nbufs * buf_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (mem != MAP_FAILED)
+			{
+				std::vector<struct iovec> iov(nbufs);
+				for (unsigned int i = 0; i < nbufs; ++i)
+				{
+					iov[i].iov_base = (char*)mem + (size_t)i * buf_size;
+					iov[i].iov_len = buf_size;
+				}
+				if (!uring_register(fd_, IORING_REGISTER_BUFFERS, &iov[0], nbufs))
+				{
+					bufs_ = (char*)mem;
+					buf_size_ = buf_size;
+					nbufs_ = nbufs;
+					free_bufs_.reserve(nbufs);
+					for (unsigned int i = nbufs; i > 0; --i)
+						free_bufs_.push_back(i - 1);
+				}
+				else
+					munmap(mem, nbufs * buf_size);
+			}
+		}
+		return 0;
+	}
+
+	Ruring::~Ruring()
+	{
+		if (bufs_) munmap(bufs_, (size_t)nbufs_ * buf_size_);
+		if (sqes_) munmap(sqes_, sqes_size_);
+		if (cq_ptr_ != MAP_FAILED) munmap(cq_ptr_, cq_size_);
+		if (sq_ptr_ != MAP_FAILED) munmap(sq_ptr_, sq_size_);
+		if (fd_ >= 0) close(fd_);
+	}
+
+	struct io_uring_sqe *Ruring::getSqe()
+	{
+		unsigned int head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+		if (sqe_tail_ - head >= sq_entries_)
+		{
+			if (submit(0)) return NULL;
+			head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+			if (sqe_tail_ - head >= sq_entries_) return NULL;
+		}
+		unsigned int idx = sqe_tail_ & sq_mask_;
+		struct io_uring_sqe *sqe = &sqes_[idx];
+		memset(sqe, 0, sizeof(*sqe));
+		sq_array_[idx] = idx;
+		++sqe_tail_;
+		return sqe;
+	}
+
+	int Ruring::submit(unsigned int wait_nr, int timeout_ms)
+	{
+		if (wait_nr && timeout_ms >= 0)
+		{
+			// completes after the timeout or as soon as anything else completes
+			struct io_uring_sqe *sqe = getSqe();
+			if (!sqe) return -EBUSY;
+			ts_.tv_sec = timeout_ms / 1000;
+			ts_.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+			sqe->opcode = IORING_OP_TIMEOUT;
+			sqe->fd = -1;
+			sqe->addr = (uint64_t)(uintptr_t)&ts_;
+			sqe->len = 1;
+			sqe->off = 1;
+			sqe->user_data = 0;
+		}
+		unsigned int to_submit = sqe_tail_ - *sq_tail_;
+		__atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+		for (;;)
+		{
+			int n = uring_enter(fd_, to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+			if (n >= 0)
+			{
+				if ((unsigned int)n >= to_submit) return 0;
+				to_submit -= n;
+				continue;
+			}
+			if (errno == EINTR)
+			{
+				if (wait_nr) return 0; // the caller just sees fewer completions
+				continue;
+			}
+			return -errno;
+		}
+	}
+
+	int Ruring::acquireBuffer()
+	{
+		if (free_bufs_.empty()) return -1;
+		int i = free_bufs_.back();
+		free_bufs_.pop_back();
+		return i;
+	}
+
+} // namespace Rconnection2
+
+#endif // __linux__ && RCONNECTION2_IO_URING
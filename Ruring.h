@@ -0,0 +1,130 @@
+/*
+ *  C++ Interface to Rserve - io_uring submission/completion rings
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+/* Ruring is the thin layer over the io_uring system calls used by the
+   io_uring backend of Rreactor (internal - not part of the public API).
+   SQEs are only queued by getSqe(); one submit() hands everything queued
+   by all connections to the kernel and waits for completions in the same
+   system call. It also owns a slab of registered (fixed) buffers for the
+   short reads of the read-ahead path. Built with RCONNECTION2_IO_URING only,
+   no liburing is needed.
+*/
+#pragma once
+
+#ifndef __RURING_H__
+#define __RURING_H__
+
+#if defined(__linux__) && defined(RCONNECTION2_IO_URING)
+
+#include <linux/io_uring.h>
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+namespace Rconnection2 {
+
+	class Ruring
+	{
+	private:
+		explicit Ruring(const Ruring&);
+		Ruring& operator=(const Ruring&);
+
+	protected:
+		int fd_;
+		unsigned int features_;
+
+		// mapped rings
+		void *sq_ptr_;
+		size_t sq_size_;
+		void *cq_ptr_;
+		size_t cq_size_;
+		struct io_uring_sqe *sqes_;
+		size_t sqes_size_;
+
+		unsigned int *sq_head_;
+		unsigned int *sq_tail_;
+		unsigned int sq_mask_;
+		unsigned int sq_entries_;
+		unsigned int *sq_array_;
+		unsigned int sqe_tail_;  // queued locally, published by submit()
+
+		unsigned int *cq_head_;
+		unsigned int *cq_tail_;
+		unsigned int cq_mask_;
+		struct io_uring_cqe *cqes_;
+
+		struct __kernel_timespec ts_; // of the last timeout entry
+
+		// registered buffers
+		char *bufs_;
+		size_t buf_size_;
+		unsigned int nbufs_;
+		std::vector<int> free_bufs_;
+
+		Ruring();
+		int setup(unsigned int entries, unsigned int nbufs, size_t buf_size);
+
+	public:
+		/** returns NULL if the kernel has no (usable) io_uring */
+		static std::unique_ptr<Ruring> create(unsigned int entries, unsigned int nbufs, size_t buf_size);
+		~Ruring();
+
+		/** a zeroed SQE, passing the queue to the kernel first if it is full.
+			NULL if that fails */
+		struct io_uring_sqe *getSqe();
+
+		/** submits the queued SQEs and waits for at least wait_nr completions,
+			but not longer than timeout_ms (-1 = forever). returns 0 or -errno */
+		int submit(unsigned int wait_nr, int timeout_ms = -1);
+
+		/** calls f(cqe) for every completion available, except the ones of
+			the internal timeouts (user_data 0) */
+		template<class F> unsigned int reap(const F& f)
+		{
+			unsigned int head = *cq_head_;
+			unsigned int tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+			unsigned int n = 0;
+			while (head != tail)
+			{
+				struct io_uring_cqe cqe = cqes_[head & cq_mask_];
+				// free the slot before the callback, it may submit and wait
+				__atomic_store_n(cq_head_, ++head, __ATOMIC_RELEASE);
+				if (cqe.user_data)
+				{
+					f(cqe);
+					++n;
+				}
+				tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+			}
+			return n;
+		}
+
+		/** index of a free registered buffer or -1 */
+		int acquireBuffer();
+		void releaseBuffer(int index) { free_bufs_.push_back(index); }
+		char *buffer(int index) const { return bufs_ + (size_t)index * buf_size_; }
+		size_t bufferSize() const { return buf_size_; }
+	};
+
+} // namespace Rconnection2
+
+#endif // __linux__ && RCONNECTION2_IO_URING
+
+#endif
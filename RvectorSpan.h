@@ -0,0 +1,207 @@
+/*
+ *  C++ Interface to Rserve - typed spans over vector payloads
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+/* RvectorSpan<T> checks the XT type of an Rexp once and then exposes its
+   values as a plain pointer and length, so loops over it are unchecked and
+   free for the compiler to vectorize, and range-for and the standard
+   algorithms work on it directly:
+
+   RvectorSpan<int>                   XT_ARRAY_INT, XT_INT
+   RvectorSpan<double>                XT_ARRAY_DOUBLE, XT_DOUBLE
+   RvectorSpan<unsigned char>         XT_ARRAY_BOOL (0, 1, NA_LOGICAL_BYTE), XT_RAW
+   RvectorSpan<std::complex<double> > XT_ARRAY_CPLX
+   RvectorSpan<RstringRef>            XT_ARRAY_STR, NA elements have NULL data
+
+   A span of another type is empty. Spans do not own anything: the Rexp
+   (and with it the message buffer) must outlive them.
+
+	   auto x = conn->eval<Rexp>("rnorm(1e6)");
+	   RvectorSpan<double> v(x);
+	   double sum = std::accumulate(v.begin(), v.end(), 0.0);
+*/
+#pragma once
+
+#ifndef __RVECTORSPAN_H__
+#define __RVECTORSPAN_H__
+
+#include "Rconnection2.h"
+
+#include <iterator>
+
+namespace Rconnection2 {
+
+	/** contiguous elements owned by someone else */
+	template<class T> struct Rspan
+	{
+		typedef T value_type;
+		typedef const T* iterator;
+		typedef const T* const_iterator;
+
+		const T *data;
+		size_t size;
+
+		Rspan() : data(NULL), size(0) {}
+		Rspan(const T *data_, size_t size_) : data(data_), size(size_) {}
+
+		bool empty() const { return size == 0; }
+		const T *begin() const { return data; }
+		const T *end() const { return data + size; }
+		const T& operator[](size_t i) const { return data[i]; }
+	};
+
+	/** which payloads hold values of type T - only the types listed above */
+	template<class T> struct RvectorTraits;
+
+	template<> struct RvectorTraits<int>
+	{
+		static bool accepts(int type) { return type == XT_ARRAY_INT || type == XT_INT; }
+		static Rspan<int> span(const Rexp& exp)
+		{
+			return Rspan<int>((const int*)exp.get_data(), exp.byteLength() / sizeof(int));
+		}
+	};
+
+	template<> struct RvectorTraits<double>
+	{
+		static bool accepts(int type) { return type == XT_ARRAY_DOUBLE || type == XT_DOUBLE; }
+		static Rspan<double> span(const Rexp& exp)
+		{
+			return Rspan<double>((const double*)exp.get_data(), exp.byteLength() / sizeof(double));
+		}
+	};
+
+	template<> struct RvectorTraits<std::complex<double> >
+	{
+		static bool accepts(int type) { return type == XT_ARRAY_CPLX; }
+		static Rspan<std::complex<double> > span(const Rexp& exp)
+		{
+			return Rspan<std::complex<double> >((const std::complex<double>*)exp.get_data(),
+				exp.byteLength() / sizeof(std::complex<double>));
+		}
+	};
+
+	template<> struct RvectorTraits<unsigned char>
+	{
+		static bool accepts(int type) { return type == XT_ARRAY_BOOL || type == XT_RAW; }
+		static Rspan<unsigned char> span(const Rexp& exp)
+		{
+			if (exp.get_type() == XT_RAW)
+			{
+				const Rraw& r = static_cast<const Rraw&>(exp);
+				return Rspan<unsigned char>(r.rawArray(), r.count());
+			}
+			const Rlogical& l = static_cast<const Rlogical&>(exp);
+			return Rspan<unsigned char>(l.logicalArray(), l.count());
+		}
+	};
+
+	template<class T> class RvectorSpan : public Rspan<T>
+	{
+	public:
+		RvectorSpan() {}
+		/** empty unless exp holds values of type T */
+		explicit RvectorSpan(const Rexp& exp) : Rspan<T>(accepts(exp) ? RvectorTraits<T>::span(exp) : Rspan<T>()) {}
+		template<class E> explicit RvectorSpan(const std::shared_ptr<E>& exp)
+			: Rspan<T>((exp && accepts(*exp)) ? RvectorTraits<T>::span(*exp) : Rspan<T>()) {}
+
+		static bool accepts(const Rexp& exp) { return RvectorTraits<T>::accepts(exp.get_type()); }
+	};
+
+	/** the strings of an Rstrings as references into the message buffer.
+		walks the pointer and length arrays Rstrings keeps side by side */
+	template<> class RvectorSpan<RstringRef>
+	{
+	public:
+		typedef RstringRef value_type;
+
+		size_t size;
+
+		/** random access; dereferencing yields the RstringRef by value */
+		class iterator
+		{
+		public:
+			typedef std::random_access_iterator_tag iterator_category;
+			typedef RstringRef value_type;
+			typedef ptrdiff_t difference_type;
+			typedef const RstringRef* pointer;
+			typedef RstringRef reference;
+
+			iterator() : strs_(NULL), lens_(NULL) {}
+			iterator(const char *const *strs, const Rsize_t *lens) : strs_(strs), lens_(lens) {}
+
+			RstringRef operator*() const { RstringRef r = { *strs_, *lens_ }; return r; }
+			RstringRef operator[](difference_type n) const { return *(*this + n); }
+
+			iterator& operator++() { ++strs_; ++lens_; return *this; }
+			iterator operator++(int) { iterator it(*this); ++*this; return it; }
+			iterator& operator--() { --strs_; --lens_; return *this; }
+			iterator operator--(int) { iterator it(*this); --*this; return it; }
+			iterator& operator+=(difference_type n) { strs_ += n; lens_ += n; return *this; }
+			iterator& operator-=(difference_type n) { strs_ -= n; lens_ -= n; return *this; }
+			iterator operator+(difference_type n) const { return iterator(strs_ + n, lens_ + n); }
+			iterator operator-(difference_type n) const { return iterator(strs_ - n, lens_ - n); }
+			friend iterator operator+(difference_type n, const iterator& it) { return it + n; }
+			difference_type operator-(const iterator& other) const { return strs_ - other.strs_; }
+
+			bool operator==(const iterator& other) const { return strs_ == other.strs_; }
+			bool operator!=(const iterator& other) const { return strs_ != other.strs_; }
+			bool operator<(const iterator& other) const { return strs_ < other.strs_; }
+			bool operator>(const iterator& other) const { return strs_ > other.strs_; }
+			bool operator<=(const iterator& other) const { return strs_ <= other.strs_; }
+			bool operator>=(const iterator& other) const { return strs_ >= other.strs_; }
+
+		private:
+			const char *const *strs_;
+			const Rsize_t *lens_;
+		};
+		typedef iterator const_iterator;
+
+		RvectorSpan() : size(0), strs_(NULL), lens_(NULL) {}
+		explicit RvectorSpan(const Rexp& exp) : size(0), strs_(NULL), lens_(NULL) { init(exp); }
+		template<class E> explicit RvectorSpan(const std::shared_ptr<E>& exp) : size(0), strs_(NULL), lens_(NULL)
+		{
+			if (exp) init(*exp);
+		}
+
+		static bool accepts(const Rexp& exp) { return exp.get_type() == XT_ARRAY_STR; }
+
+		bool empty() const { return size == 0; }
+		iterator begin() const { return iterator(strs_, lens_); }
+		iterator end() const { return iterator(strs_ + size, lens_ + size); }
+		RstringRef operator[](size_t i) const { RstringRef r = { strs_[i], lens_[i] }; return r; }
+
+	private:
+		const char *const *strs_;
+		const Rsize_t *lens_;
+
+		void init(const Rexp& exp)
+		{
+			if (!accepts(exp)) return;
+			const Rstrings& s = static_cast<const Rstrings&>(exp);
+			size = s.strings().size();
+			if (!size) return;
+			strs_ = &s.strings()[0];
+			lens_ = &s.lengths()[0];
+		}
+	};
+
+} // namespace Rconnection2
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ *  C++ Interface to Rserve - fake server for the benchmarks
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+/* fake_rserve - a minimal QAP1 server for the client benchmarks, one thread
+   per connection, no R involved. eval of "n" answers n doubles (0, 1, ...),
+   every other command a bare RESP_OK. loopback only.
+
+	   bench/fake_rserve <port>
+*/
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static bool readAll(int s, void *buf, size_t n)
+{
+	char *p = (char*)buf;
+	while (n)
+	{
+		ssize_t k = read(s, p, n);
+		if (k <= 0) return false;
+		p += k;
+		n -= k;
+	}
+	return true;
+}
+
+static bool writeAll(int s, const void *buf, size_t n)
+{
+	const char *p = (const char*)buf;
+	while (n)
+	{
+		ssize_t k = write(s, p, n);
+		if (k <= 0) return false;
+		p += k;
+		n -= k;
+	}
+	return true;
+}
+
+static std::mutex cache_mtx;
+static std::map<unsigned int, std::string> cache;
+
+// RESP_OK, DT_SEXP, XT_ARRAY_DOUBLE of n elements (n < 2M, no large headers)
+static const std::string& doubles(unsigned int n)
+{
+	std::lock_guard<std::mutex> lk(cache_mtx);
+	std::string& r = cache[n];
+	if (r.empty())
+	{
+		uint32_t xlen = 8 * n, slen = xlen + 4;
+		uint32_t h[6] = { 0x10001, slen + 4, 0, 0, 10u | (slen << 8), 33u | (xlen << 8) };
+		r.assign((const char*)h, sizeof(h));
+		for (unsigned int i = 0; i < n; ++i)
+		{
+			double d = i;
+			r.append((const char*)&d, sizeof(d));
+		}
+	}
+	return r;
+}
+
+static void serve(int s)
+{
+	int one = 1;
+	setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	const char id[] = "Rsrv0103QAP1\r\n\r\n--------------\r\n";
+	if (!writeAll(s, id, 32))
+	{
+		close(s);
+		return;
+	}
+	std::vector<char> par;
+	uint32_t h[4];
+	while (readAll(s, h, sizeof(h)))
+	{
+		par.resize(h[1] + 1);
+		if (h[1] && !readAll(s, &par[0], h[1])) break;
+		par[h[1]] = 0;
+		if (h[0] == 3 && h[1] > 4) // CMD_eval, DT_STRING
+		{
+			const std::string& r = doubles((unsigned int)atoi(&par[4]));
+			if (!writeAll(s, r.data(), r.size())) break;
+		}
+		else
+		{
+			uint32_t ok[4] = { 0x10001, 0, 0, 0 };
+			if (!writeAll(s, ok, sizeof(ok))) break;
+		}
+	}
+	close(s);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <port>\n", argv[0]);
+		return 1;
+	}
+	int l = socket(AF_INET, SOCK_STREAM, 0), one = 1;
+	setsockopt(l, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	sockaddr_in sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons((uint16_t)atoi(argv[1]));
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(l, (sockaddr*)&sa, sizeof(sa)) || listen(l, 512))
+	{
+		perror("fake_rserve");
+		return 1;
+	}
+	for (;;)
+	{
+		int s = accept(l, NULL, NULL);
+		if (s >= 0) std::thread(serve, s).detach();
+	}
+}
@@ -0,0 +1,82 @@
+/*
+ *  C++ Interface to Rserve - request latency benchmark
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+/* latency_bench - round trip latency of small blocking requests, against
+   bench/fake_rserve or a real Rserve. alternates eval("10") and
+   voidEval("1") on one connection and prints p50/p99 of each.
+
+	   bench/latency_bench <port> [requests]
+*/
+#include "Rconnection2.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace Rconnection2;
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double micros(bench_clock::time_point a, bench_clock::time_point b)
+{
+	return std::chrono::duration<double, std::micro>(b - a).count();
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <port> [requests]\n", argv[0]);
+		return 1;
+	}
+	size_t n = (argc > 2) ? (size_t)atoi(argv[2]) : 20000;
+	if (n == 0) n = 1;
+	std::shared_ptr<Rconnection> c = Rconnection::create("127.0.0.1", atoi(argv[1]));
+	int res = c->connect();
+	if (res)
+	{
+		fprintf(stderr, "latency_bench: connect failed (%d)\n", res);
+		return 1;
+	}
+	std::vector<double> ev, vv;
+	ev.reserve(n);
+	vv.reserve(n);
+	for (size_t k = 0; k < n; ++k)
+	{
+		bench_clock::time_point a = bench_clock::now();
+		int status = 0;
+		if (!c->eval_to_Rexp("10", &status, 0) || status) res = status ? status : -1;
+		bench_clock::time_point b = bench_clock::now();
+		if (!res) res = c->voidEval("1");
+		if (res)
+		{
+			fprintf(stderr, "latency_bench: request failed (%d)\n", res);
+			return 1;
+		}
+		ev.push_back(micros(a, b));
+		vv.push_back(micros(b, bench_clock::now()));
+	}
+	std::sort(ev.begin(), ev.end());
+	std::sort(vv.begin(), vv.end());
+	printf("eval p50 %.2f us p99 %.2f us | voidEval p50 %.2f us p99 %.2f us\n",
+		ev[n / 2], ev[n * 99 / 100], vv[n / 2], vv[n * 99 / 100]);
+	return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ *  C++ Interface to Rserve - reactor backend benchmark
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+/* reactor_bench - eval round trips through the Rreactor backends and the
+   blocking client, against bench/fake_rserve or a real Rserve.
+
+	   bench/reactor_bench <epoll|uring|blocking> <port> <conns> <requests per conn> <expr> <in flight per conn>
+
+   epoll and uring multiplex all connections on one reactor thread, keeping
+   <in flight> evals queued per connection; blocking runs one thread per
+   connection with one eval at a time. latency is taken from queueing a
+   request to its callback, so it includes the wait behind earlier ones.
+   uring needs a build with IO_URING=1.
+*/
+#include "AsyncRconnection.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+using namespace Rconnection2;
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double micros(bench_clock::time_point a, bench_clock::time_point b)
+{
+	return std::chrono::duration<double, std::micro>(b - a).count();
+}
+
+static void fail(const char *what, int status)
+{
+	fprintf(stderr, "reactor_bench: %s failed (%d)\n", what, status);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 7)
+	{
+		fprintf(stderr, "usage: %s <epoll|uring|blocking> <port> <conns> <requests per conn> <expr> <in flight per conn>\n", argv[0]);
+		return 1;
+	}
+	const char *mode = argv[1];
+	int port = atoi(argv[2]), conns = atoi(argv[3]), reqs = atoi(argv[4]), depth = atoi(argv[6]);
+	const char *cmd = argv[5];
+	std::vector<double> lat;
+	lat.reserve((size_t)conns * reqs);
+	bench_clock::time_point t0, t1;
+
+	if (!strcmp(mode, "blocking"))
+	{
+		std::vector< std::vector<double> > per(conns);
+		std::vector< std::shared_ptr<Rconnection> > c(conns);
+		for (int i = 0; i < conns; ++i)
+		{
+			c[i] = Rconnection::create("127.0.0.1", port);
+			int res = c[i]->connect();
+			if (res) fail("connect", res);
+		}
+		std::vector<std::thread> threads;
+		t0 = bench_clock::now();
+		for (int i = 0; i < conns; ++i)
+			threads.emplace_back([&, i]()
+			{
+				for (int k = 0; k < reqs; ++k)
+				{
+					bench_clock::time_point a = bench_clock::now();
+					int status = 0;
+					if (!c[i]->eval_to_Rexp(cmd, &status, 0) || status) fail("eval", status);
+					per[i].push_back(micros(a, bench_clock::now()));
+				}
+			});
+		for (auto& t : threads) t.join();
+		t1 = bench_clock::now();
+		for (auto& v : per) lat.insert(lat.end(), v.begin(), v.end());
+	}
+	else
+	{
+		Rreactor::Backend be = !strcmp(mode, "uring") ? Rreactor::be_uring : Rreactor::be_epoll;
+		std::shared_ptr<Rreactor> r = Rreactor::create(be);
+		if (!r->valid() || r->backend() != be)
+		{
+			fprintf(stderr, "reactor_bench: backend %s not available\n", mode);
+			return 1;
+		}
+		std::vector< std::shared_ptr<AsyncRconnection> > c(conns);
+		int ready = 0;
+		for (int i = 0; i < conns; ++i)
+		{
+			c[i] = AsyncRconnection::create(r, "127.0.0.1", port);
+			c[i]->connect([&](int status) { if (status) fail("connect", status); ++ready; });
+		}
+		while (ready < conns) r->runOnce(100);
+
+		std::vector<int> issued(conns, 0);
+		size_t done = 0, total = (size_t)conns * reqs;
+		std::function<void(int)> issue = [&](int i)
+		{
+			if (issued[i] >= reqs) return;
+			++issued[i];
+			bench_clock::time_point a = bench_clock::now();
+			c[i]->eval(cmd, [&, i, a](int status, const std::shared_ptr<Rexp>& exp)
+			{
+				if (status || !exp) fail("eval", status);
+				lat.push_back(micros(a, bench_clock::now()));
+				++done;
+				issue(i);
+			});
+		};
+		t0 = bench_clock::now();
+		for (int i = 0; i < conns; ++i)
+			for (int d = 0; d < depth; ++d)
+				issue(i);
+		while (done < total) r->runOnce(1000);
+		t1 = bench_clock::now();
+	}
+
+	std::sort(lat.begin(), lat.end());
+	printf("%-8s conns=%-3d expr=%-7s in-flight=%d  %8.0f req/s  p50 %8.1f us  p99 %9.1f us\n", mode, conns, cmd, depth,
+		lat.size() / (micros(t0, t1) / 1e6), lat[lat.size() / 2], lat[lat.size() * 99 / 100]);
+	return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ *  C++ Interface to Rserve - XT_ARRAY_STR decoding benchmark
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+/* strings_bench - splitting a character vector into its strings, the way
+   Rstrings::fix_content() did it before (a byte loop collecting pointers)
+   against the current splitter, which also records the lengths and NAs.
+   builds one message of random strings of 7-30 bytes, every 100th NA, and
+   decodes it through Rexp::create() like a received reply. prints the best
+   and the median time of each.
+
+	   bench/strings_bench [strings] [rounds]
+*/
+#include "Rconnection2.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace Rconnection2;
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double millis(bench_clock::time_point a, bench_clock::time_point b)
+{
+	return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+// the splitter Rstrings::fix_content() used before SSE2 and NA decoding
+static void oldSplit(char *data, unsigned int len, std::vector<const char*>& cont)
+{
+	cont.clear();
+	char *c = data;
+	unsigned i = 0;
+	while (i < len)
+	{
+		char* p = c;
+		while (*c && i < len) ++c, ++i;
+		if (i < len)
+		{
+			cont.push_back(p);
+			++c; ++i;
+		}
+	}
+}
+
+static void report(const char *name, std::vector<double>& ms)
+{
+	std::sort(ms.begin(), ms.end());
+	printf("%-18s best %7.2f ms, median %7.2f ms\n", name, ms[0], ms[ms.size() / 2]);
+}
+
+int main(int argc, char **argv)
+{
+	size_t n = (argc > 1) ? (size_t)atoi(argv[1]) : 1000000;
+	size_t rounds = (argc > 2) ? (size_t)atoi(argv[2]) : 21;
+	if (n == 0) n = 1;
+	if (rounds == 0) rounds = 1;
+
+	// DT_SEXP header, XT_ARRAY_STR header, the strings padded with \1
+	std::string payload;
+	srand(1);
+	for (size_t i = 0; i < n; ++i)
+	{
+		if (i % 100 == 99)
+			payload += '\xff';
+		else
+			for (int k = 7 + rand() % 24; k > 0; --k)
+				payload += (char)('a' + rand() % 26);
+		payload += '\0';
+	}
+	while (payload.size() % 4) payload += '\1';
+	// large headers (a second word with the upper length bits), 1M strings need them
+	uint64_t len = payload.size();
+	std::vector<unsigned int> words(4 + len / 4);
+	words[0] = DT_SEXP | DT_LARGE | (unsigned int)(((len + 8) & 0xffffff) << 8);
+	words[1] = (unsigned int)((len + 8) >> 24);
+	words[2] = XT_ARRAY_STR | XT_LARGE | (unsigned int)((len & 0xffffff) << 8);
+	words[3] = (unsigned int)(len >> 24);
+	memcpy(&words[4], payload.data(), len);
+	std::shared_ptr<Rmessage> msg = Rmessage::create(RESP_OK, &words[0], words.size() * 4, 1);
+	msg->parse();
+
+	std::vector<double> old_ms, new_ms;
+	size_t old_count = 0, new_count = 0;
+	for (size_t r = 0; r < rounds; ++r)
+	{
+		std::vector<char> copy(payload.begin(), payload.end());
+		std::vector<const char*> cont; // fresh, like the vectors of a new Rstrings
+		bench_clock::time_point a = bench_clock::now();
+		oldSplit(&copy[0], (unsigned int)copy.size(), cont);
+		bench_clock::time_point b = bench_clock::now();
+		old_ms.push_back(millis(a, b));
+		old_count = cont.size();
+
+		a = bench_clock::now();
+		std::shared_ptr<Rexp> e = Rexp::create(msg);
+		b = bench_clock::now();
+		new_ms.push_back(millis(a, b));
+		if (!e || e->get_type() != XT_ARRAY_STR)
+		{
+			fprintf(stderr, "strings_bench: the message did not decode\n");
+			return 1;
+		}
+		new_count = static_cast<Rstrings*>(e.get())->strings().size();
+	}
+	printf("%u strings, %u bytes\n", (unsigned)n, (unsigned)payload.size());
+	if (old_count != n || new_count != n)
+	{
+		fprintf(stderr, "strings_bench: split into %u (old) and %u (new) strings\n",
+			(unsigned)old_count, (unsigned)new_count);
+		return 1;
+	}
+	report("old byte loop", old_ms);
+	report("fix_content", new_ms);
+	return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ *  C++ Interface to Rserve - byte swap kernel benchmark
+ *  Copyright (C) 2026 the Rconnection2 contributors, All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; version 2.1 of the License
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Leser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *  $Id$
+ */
+
+/* swap_bench - the swapBytes32/64 kernels of Rswap against the scalar one.
+   every kernel selectSwapKernel() accepts on this machine is first checked
+   against the scalar result for all lengths up to 70 elements (the vector
+   tails) at every misalignment up to 7 bytes, then timed on arrays of
+   several sizes. prints GB/s and the speedup over scalar.
+
+	   bench/swap_bench [max MB]
+*/
+#include "Rswap.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace Rconnection2;
+
+typedef std::chrono::steady_clock bench_clock;
+
+static const char *kernels[] = { "scalar", "ssse3", "avx2" };
+
+#define CHECK_MAX_ELEMENTS 70
+#define CHECK_MAX_OFFSET 8
+
+typedef void (*swap_fn)(void *data, size_t n);
+
+static void fill(unsigned char *p, size_t bytes)
+{
+	for (size_t i = 0; i < bytes; ++i)
+		p[i] = (unsigned char)(i * 131 + 7);
+}
+
+// the swapped bytes match the scalar kernel and nothing around them changed
+static bool check(const char *kernel, swap_fn swap, size_t width)
+{
+	std::vector<unsigned char> ref(CHECK_MAX_ELEMENTS * width + 2 * CHECK_MAX_OFFSET);
+	std::vector<unsigned char> got(ref.size());
+	for (size_t off = 0; off < CHECK_MAX_OFFSET; ++off)
+		for (size_t n = 0; n <= CHECK_MAX_ELEMENTS; ++n)
+		{
+			fill(&ref[0], ref.size());
+			fill(&got[0], got.size());
+			selectSwapKernel("scalar");
+			swap(&ref[off], n);
+			selectSwapKernel(kernel);
+			swap(&got[off], n);
+			if (memcmp(&ref[0], &got[0], ref.size()))
+			{
+				printf("%s: %u-bit swap of %u elements at offset %u differs from scalar\n",
+					kernel, (unsigned)(width * 8), (unsigned)n, (unsigned)off);
+				return false;
+			}
+		}
+	return true;
+}
+
+// GB/s of swapping bytes at data (rounds of the whole array for about 0.2 s)
+static double throughput(swap_fn swap, size_t width, unsigned char *data, size_t bytes)
+{
+	size_t n = bytes / width;
+	size_t rounds = 0;
+	swap(data, n); // warm up
+	bench_clock::time_point t0 = bench_clock::now(), t1;
+	do
+	{
+		for (int k = 0; k < 8; ++k)
+			swap(data, n);
+		rounds += 8;
+		t1 = bench_clock::now();
+	} while (t1 - t0 < std::chrono::milliseconds(200));
+	return (double)rounds * n * width / std::chrono::duration<double>(t1 - t0).count() / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	size_t max_mb = (argc > 1) ? (size_t)atoi(argv[1]) : 16;
+	if (max_mb == 0) max_mb = 1;
+
+	std::vector<const char*> usable;
+	for (const char *k : kernels)
+	{
+		if (!selectSwapKernel(k))
+		{
+			printf("%-6s not supported here\n", k);
+			continue;
+		}
+		if (!check(k, swapBytes32, 4) || !check(k, swapBytes64, 8)) return 1;
+		usable.push_back(k);
+	}
+	printf("%u kernels match scalar for 0..%d elements at offsets 0..%d\n\n",
+		(unsigned)usable.size(), CHECK_MAX_ELEMENTS, CHECK_MAX_OFFSET - 1);
+
+	std::vector<unsigned char> buf(max_mb * 1024 * 1024 + CHECK_MAX_OFFSET);
+	fill(&buf[0], buf.size());
+	const size_t sizes[] = { 4096, 65536, 1024 * 1024, 16 * 1024 * 1024 };
+	const size_t offsets[] = { 0, 1, 4 };
+	printf("%-6s %5s %10s %6s %9s %8s\n", "kernel", "bits", "bytes", "offset", "GB/s", "speedup");
+	for (size_t width = 4; width <= 8; width += 4)
+	{
+		swap_fn swap = (width == 4) ? swapBytes32 : swapBytes64;
+		for (size_t bytes : sizes)
+		{
+			if (bytes > max_mb * 1024 * 1024) continue;
+			for (size_t off : offsets)
+			{
+				double scalar = 0.0;
+				for (const char *k : usable)
+				{
+					selectSwapKernel(k);
+					double gbs = throughput(swap, width, &buf[off], bytes);
+					if (!strcmp(k, "scalar")) scalar = gbs;
+					printf("%-6s %5u %10u %6u %9.2f %7.2fx\n", k, (unsigned)(width * 8), (unsigned)bytes,
+						(unsigned)off, gbs, scalar > 0.0 ? gbs / scalar : 0.0);
+				}
+			}
+		}
+	}
+	return 0;
+}